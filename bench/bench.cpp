@@ -0,0 +1,247 @@
+// 基准测试：生成一段命令序列，直接调用 BookManager/UserManager/LogManager 执行，
+// 以 JSON 输出每种命令的延迟分位数、吞吐量与读写字节数。
+//
+// bench [--mix buy|search|admin] [--books N] [--users N] [--commands N] [--seed N]
+//       [--dir PATH] [--output FILE] [--emit]
+//
+// 默认在新建的临时目录中运行并在结束后删除；--dir 指定的目录保留。
+// --emit 只把生成的命令（先建库后计时部分）输出到标准输出，可以直接喂给 code 重放。
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "books.h"
+#include "commands.h"
+#include "logs.h"
+#include "output.h"
+#include "users.h"
+#include "wal.h"
+#include "workload.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// 进程经 read/write 类系统调用读写的字节数（/proc/self/io 的 rchar/wchar），
+// 包括命中内核页缓存的读写，不包括 mmap 的访问。不支持时均为 0.
+struct IoCounters {
+  long long read = 0;
+  long long written = 0;
+};
+IoCounters ioCounters () {
+  IoCounters counters;
+  int fd = ::open("/proc/self/io", O_RDONLY);
+  if (fd < 0) return counters;
+  char buf[512];
+  ssize_t size = ::read(fd, buf, sizeof(buf) - 1);
+  ::close(fd);
+  if (size <= 0) return counters;
+  buf[size] = '\0';
+  std::sscanf(buf, "rchar: %lld\nwchar: %lld", &counters.read, &counters.written);
+  return counters;
+}
+
+struct VerbStats {
+  std::vector<double> micros;
+  long long invalid = 0;
+  long long bytesRead = 0;
+  long long bytesWritten = 0;
+};
+
+// 命令的种类：首个词，show/report 带上子命令（如 "show finance"），
+// 以免把报表与普通查询的延迟混在一起。
+std::string verbOf (std::string_view command) {
+  size_t end = command.find(' ');
+  std::string_view verb = command.substr(0, end);
+  if ((verb == "show" || verb == "report") && end != std::string_view::npos) {
+    std::string_view rest = command.substr(end + 1);
+    std::string_view sub = rest.substr(0, rest.find(' '));
+    if (!sub.empty() && sub[0] != '-') return std::string(verb) + " " + std::string(sub);
+  }
+  return std::string(verb);
+}
+
+// 最近秩法的分位数，sorted 非空且已排序。
+double percentile (const std::vector<double> &sorted, double p) {
+  size_t rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+  return sorted[std::max<size_t>(rank, 1) - 1];
+}
+
+std::string jsonString (std::string_view str) {
+  std::string result = "\"";
+  for (char ch : str) {
+    if (ch == '"' || ch == '\\') result += '\\';
+    result += ch;
+  }
+  return result + "\"";
+}
+
+void usage () {
+  std::cerr << "usage: bench [--mix buy|search|admin] [--books N] [--users N] [--commands N] [--seed N] [--dir PATH] [--output FILE] [--emit]\n";
+  std::exit(2);
+}
+
+} // namespace
+
+int main (int argc, char **argv) {
+  WorkloadConfig config;
+  std::string dir, output;
+  bool emit = false;
+  try {
+    for (int i = 1; i < argc; ++i) {
+      std::string_view flag = argv[i];
+      if (flag == "--emit") {
+        emit = true;
+        continue;
+      }
+      if (i + 1 == argc) usage();
+      std::string value = argv[++i];
+      if (flag == "--mix") config.mix = value;
+      else if (flag == "--books") config.books = std::stoll(value);
+      else if (flag == "--users") config.users = std::stoll(value);
+      else if (flag == "--commands") config.commands = std::stoll(value);
+      else if (flag == "--seed") config.seed = std::stoull(value);
+      else if (flag == "--dir") dir = value;
+      else if (flag == "--output") output = value;
+      else usage();
+    }
+  } catch (const std::logic_error &) {
+    usage();
+  }
+
+  Workload workload;
+  try {
+    workload = generateWorkload(config);
+  } catch (const std::exception &) {
+    usage();
+  }
+  if (emit) {
+    for (const auto &command : workload.setup) std::cout << command << '\n';
+    for (const auto &command : workload.commands) std::cout << command << '\n';
+    return 0;
+  }
+
+  // 数据文件都以相对路径打开，在工作目录中运行。
+  bool temporary = dir.empty();
+  if (temporary) {
+    char path[] = "/tmp/bookstore-bench-XXXXXX";
+    if (!mkdtemp(path)) {
+      std::perror("mkdtemp");
+      return 1;
+    }
+    dir = path;
+  } else {
+    std::filesystem::create_directories(dir);
+  }
+  if (!output.empty()) output = std::filesystem::absolute(output);
+  std::filesystem::current_path(dir);
+
+  IoCounters initial;
+  double setupSeconds = 0, runSeconds = 0;
+  std::map<std::string, VerbStats> verbs;
+  {
+    BookManager bookManager(
+      "books",
+      kCoveringIndex ? "keyword_index_covering.dat" : "keyword_index.dat",
+      kCoveringIndex ? "author_index_covering.dat" : "author_index.dat",
+      kCoveringIndex ? "name_index_covering.dat" : "name_index.dat"
+    );
+    UserManager userManager("users");
+    LogManager logManager("log");
+    Wal::instance().open("bookstore.wal");
+
+    // 命令的输出只写入内存，每条命令后丢弃。
+    Output sink(false);
+    redirectOutput(&sink);
+
+    auto setupBegin = Clock::now();
+    for (const auto &command : workload.setup) {
+      execute(command, bookManager, userManager, logManager);
+      Wal::instance().commit();
+      sink.clear();
+    }
+    setupSeconds = std::chrono::duration<double>(Clock::now() - setupBegin).count();
+
+    // 读一次计数器本身也会计入 rchar，先测出这部分开销再扣除。
+    IoCounters probe = ioCounters();
+    long long probeBytes = ioCounters().read - probe.read;
+
+    initial = ioCounters();
+    auto runBegin = Clock::now();
+    for (const auto &command : workload.commands) {
+      IoCounters before = ioCounters();
+      auto begin = Clock::now();
+      execute(command, bookManager, userManager, logManager);
+      Wal::instance().commit();
+      auto end = Clock::now();
+      IoCounters after = ioCounters();
+
+      VerbStats &stats = verbs[verbOf(command)];
+      stats.micros.push_back(std::chrono::duration<double, std::micro>(end - begin).count());
+      stats.bytesRead += std::max(0LL, after.read - before.read - probeBytes);
+      stats.bytesWritten += after.written - before.written;
+      if (sink.view() == "Invalid\n") ++stats.invalid;
+      sink.clear();
+    }
+    runSeconds = std::chrono::duration<double>(Clock::now() - runBegin).count();
+    redirectOutput(nullptr);
+  }
+
+  long long totalRead = 0, totalWritten = 0;
+  for (const auto &[ _, stats ] : verbs) {
+    totalRead += stats.bytesRead;
+    totalWritten += stats.bytesWritten;
+  }
+
+  std::ofstream file;
+  if (!output.empty()) file.open(output);
+  std::ostream &os = output.empty() ? std::cout : file;
+  os << "{\n";
+  os << "  \"config\": {\"mix\": " << jsonString(config.mix)
+     << ", \"books\": " << config.books
+     << ", \"users\": " << config.users
+     << ", \"commands\": " << config.commands
+     << ", \"seed\": " << config.seed
+     << ", \"covering_index\": " << (kCoveringIndex ? "true" : "false") << "},\n";
+  os << "  \"setup\": {\"commands\": " << workload.setup.size() << ", \"seconds\": " << setupSeconds << "},\n";
+  os << "  \"run\": {\"commands\": " << workload.commands.size()
+     << ", \"seconds\": " << runSeconds
+     << ", \"throughput\": " << (runSeconds > 0 ? workload.commands.size() / runSeconds : 0)
+     << ", \"bytes_read\": " << totalRead
+     << ", \"bytes_written\": " << totalWritten << "},\n";
+  os << "  \"verbs\": {";
+  bool first = true;
+  for (auto &[ verb, stats ] : verbs) {
+    std::sort(stats.micros.begin(), stats.micros.end());
+    double sum = 0;
+    for (double micros : stats.micros) sum += micros;
+    long long count = stats.micros.size();
+    os << (first ? "\n" : ",\n") << "    " << jsonString(verb) << ": {"
+       << "\"count\": " << count
+       << ", \"invalid\": " << stats.invalid
+       << ", \"mean_us\": " << sum / count
+       << ", \"p50_us\": " << percentile(stats.micros, 0.5)
+       << ", \"p99_us\": " << percentile(stats.micros, 0.99)
+       << ", \"max_us\": " << stats.micros.back()
+       << ", \"bytes_read_per_command\": " << static_cast<double>(stats.bytesRead) / count
+       << ", \"bytes_written_per_command\": " << static_cast<double>(stats.bytesWritten) / count << "}";
+    first = false;
+  }
+  os << (first ? "}\n" : "\n  }\n") << "}\n";
+
+  if (temporary) std::filesystem::remove_all(dir);
+  return 0;
+}
@@ -0,0 +1,238 @@
+#include "workload.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <exception>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+// 书名、作者与关键词都由随机音节拼成的单词组成，单词之间用 '_' 连接（命令按空格切分）。
+class Generator {
+ private:
+  struct BookInfo {
+    std::string isbn, name, author;
+    std::vector<std::string> keywords;
+  };
+
+  const WorkloadConfig &config_;
+  std::mt19937_64 rng_;
+  std::vector<std::string> words_;
+  std::vector<std::string> authors_;
+  std::vector<BookInfo> books_;
+  long long workers_;
+  long long newUsers_ = 0;
+  Workload workload_;
+
+  long long uniform_ (long long lo, long long hi) {
+    return std::uniform_int_distribution<long long>(lo, hi)(rng_);
+  }
+  double chance_ () {
+    return std::uniform_real_distribution<double>(0, 1)(rng_);
+  }
+  template <typename T>
+  const T &pick_ (const std::vector<T> &items) {
+    return items[uniform_(0, items.size() - 1)];
+  }
+  static std::string decimal_ (long long cents) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%lld.%02lld", cents / 100, cents % 100);
+    return buf;
+  }
+  std::string word_ () {
+    static const char *syllables[] = { "ka", "lo", "mi", "ne", "ru", "sa", "ti", "vo", "ze", "pa", "qu", "dr", "an", "el", "or", "ix" };
+    std::string word;
+    for (long long i = uniform_(2, 3); i > 0; --i) word += syllables[uniform_(0, 15)];
+    return word;
+  }
+  std::string text_ (long long count) {
+    std::string text = pick_(words_);
+    for (long long i = 1; i < count; ++i) text += "_" + pick_(words_);
+    return text;
+  }
+  // 热门的书被访问得更多：下标取均匀分布的平方。
+  const BookInfo &book_ () {
+    double u = chance_();
+    return books_[std::min<long long>(books_.size() - 1, u * u * books_.size())];
+  }
+  std::string customer_ () {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "u%06lld", uniform_(0, config_.users - 1));
+    return buf;
+  }
+  std::string worker_ () {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "w%04lld", uniform_(0, workers_ - 1));
+    return buf;
+  }
+  void emit_ (std::string command) {
+    workload_.commands.push_back(std::move(command));
+  }
+
+  void setup_ () {
+    auto &setup = workload_.setup;
+    setup.push_back("su root sjtu");
+    char buf[64];
+    for (long long i = 0; i < workers_; ++i) {
+      std::snprintf(buf, sizeof(buf), "useradd w%04lld pw 3 worker", i);
+      setup.push_back(buf);
+    }
+    for (long long i = 0; i < config_.users; ++i) {
+      std::snprintf(buf, sizeof(buf), "useradd u%06lld pw 1 customer", i);
+      setup.push_back(buf);
+    }
+    for (long long i = 0; i < config_.books; ++i) {
+      BookInfo book;
+      std::snprintf(buf, sizeof(buf), "978%010lld", i);
+      book.isbn = buf;
+      book.name = text_(uniform_(2, 4));
+      book.author = pick_(authors_);
+      for (long long j = uniform_(1, 3); j > 0; --j) {
+        std::string keyword = pick_(words_);
+        if (std::find(book.keywords.begin(), book.keywords.end(), keyword) == book.keywords.end()) book.keywords.push_back(keyword);
+      }
+      std::string keywords = book.keywords.front();
+      for (size_t j = 1; j < book.keywords.size(); ++j) keywords += "|" + book.keywords[j];
+      long long price = uniform_(100, 20000);
+      long long quantity = uniform_(100, 1000);
+      setup.push_back("select " + book.isbn);
+      setup.push_back("modify -name=\"" + book.name + "\" -author=\"" + book.author + "\" -keyword=\"" + keywords + "\" -price=" + decimal_(price));
+      setup.push_back("import " + std::to_string(quantity) + " " + decimal_(price * quantity * 6 / 10));
+      books_.push_back(std::move(book));
+    }
+    setup.push_back("logout");
+  }
+
+  void buySession_ () {
+    if (chance_() < 0.1) {
+      emit_("su " + worker_() + " pw");
+      emit_("select " + book_().isbn);
+      emit_("import " + std::to_string(uniform_(10, 100)) + " " + decimal_(uniform_(1000, 100000)));
+      emit_("logout");
+      return;
+    }
+    emit_("su " + customer_() + " pw");
+    for (long long i = uniform_(3, 10); i > 0; --i) {
+      double r = chance_();
+      if (r < 0.7) {
+        emit_("buy " + book_().isbn + " " + std::to_string(uniform_(1, 3)));
+      } else if (r < 0.9) {
+        emit_("show -ISBN=" + book_().isbn);
+      } else {
+        emit_("show -keyword=\"" + pick_(book_().keywords) + "\"");
+      }
+    }
+    emit_("logout");
+  }
+
+  void searchSession_ () {
+    emit_("su " + customer_() + " pw");
+    for (long long i = uniform_(5, 15); i > 0; --i) {
+      double r = chance_();
+      const BookInfo &book = book_();
+      if (r < 0.3) {
+        emit_("show -name=\"" + book.name + "\"");
+      } else if (r < 0.5) {
+        emit_("show -author=\"" + book.author + "\"");
+      } else if (r < 0.7) {
+        emit_("show -keyword=\"" + pick_(book.keywords) + "\"");
+      } else if (r < 0.8) {
+        // 书名中间的一段。
+        long long begin = uniform_(0, book.name.size() - 3);
+        emit_("show -name-contains=\"" + book.name.substr(begin, uniform_(3, 5)) + "\"");
+      } else if (r < 0.85) {
+        emit_("show -name-prefix=\"" + book.name.substr(0, uniform_(2, 6)) + "\"");
+      } else if (r < 0.9) {
+        emit_("show -author-prefix=\"" + book.author.substr(0, uniform_(2, 6)) + "\"");
+      } else {
+        long long lo = uniform_(100, 19000);
+        emit_("show price " + decimal_(lo) + " " + decimal_(lo + uniform_(100, 2000)) + " 20");
+      }
+    }
+    emit_("logout");
+  }
+
+  void adminSession_ () {
+    if (chance_() < 0.5) {
+      emit_("su " + worker_() + " pw");
+      for (long long i = uniform_(2, 6); i > 0; --i) {
+        double r = chance_();
+        emit_("select " + book_().isbn);
+        if (r < 0.5) {
+          emit_("import " + std::to_string(uniform_(10, 100)) + " " + decimal_(uniform_(1000, 100000)));
+        } else if (r < 0.9) {
+          emit_("modify -price=" + decimal_(uniform_(100, 20000)));
+        } else {
+          emit_("show stock 0 " + std::to_string(uniform_(50, 200)) + " 50");
+        }
+      }
+      if (chance_() < 0.05) emit_("report myself");
+      emit_("logout");
+      return;
+    }
+    emit_("su root sjtu");
+    for (long long i = uniform_(2, 6); i > 0; --i) {
+      double r = chance_();
+      if (r < 0.35) {
+        emit_("show finance " + std::to_string(uniform_(1, 100)));
+      } else if (r < 0.4) {
+        emit_("show finance");
+      } else if (r < 0.43) {
+        emit_("report finance");
+      } else if (r < 0.45) {
+        emit_("report employee");
+      } else if (r < 0.455) {
+        emit_("log");
+      } else if (r < 0.55) {
+        char buf[64];
+        std::snprintf(buf, sizeof(buf), "useradd n%06lld pw %d new", newUsers_++, chance_() < 0.9 ? 1 : 3);
+        emit_(buf);
+      } else if (r < 0.75) {
+        emit_("select " + book_().isbn);
+        emit_("import " + std::to_string(uniform_(10, 100)) + " " + decimal_(uniform_(1000, 100000)));
+      } else if (r < 0.9) {
+        emit_("select " + book_().isbn);
+        emit_("modify -price=" + decimal_(uniform_(100, 20000)));
+      } else {
+        emit_("show stock 0 " + std::to_string(uniform_(50, 200)) + " 50");
+      }
+    }
+    emit_("logout");
+  }
+
+ public:
+  explicit Generator (const WorkloadConfig &config) :
+    config_(config),
+    rng_(config.seed),
+    workers_(std::max(1LL, config.users / 20)) {}
+
+  Workload generate () {
+    void (Generator::*session)();
+    if (config_.mix == "buy") {
+      session = &Generator::buySession_;
+    } else if (config_.mix == "search") {
+      session = &Generator::searchSession_;
+    } else if (config_.mix == "admin") {
+      session = &Generator::adminSession_;
+    } else {
+      throw std::exception();
+    }
+    if (config_.books < 1 || config_.users < 1 || config_.commands < 0) throw std::exception();
+    for (int i = 0; i < 256; ++i) words_.push_back(word_());
+    for (long long i = config_.books / 8 + 1; i > 0; --i) authors_.push_back(text_(2));
+    setup_();
+    size_t commands = static_cast<size_t>(config_.commands);
+    while (workload_.commands.size() < commands) (this->*session)();
+    workload_.commands.resize(commands);
+    return std::move(workload_);
+  }
+};
+
+} // namespace
+
+Workload generateWorkload (const WorkloadConfig &config) {
+  return Generator(config).generate();
+}
@@ -0,0 +1,27 @@
+#ifndef PANIC_BOOKSTORE_BENCH_WORKLOAD_H_
+#define PANIC_BOOKSTORE_BENCH_WORKLOAD_H_
+
+#include <string>
+#include <vector>
+
+// 基准测试的命令序列，由 seed 唯一确定。
+// mix 为 buy（顾客购买为主）、search（各种查询为主）或 admin（进货、修改与报表为主）。
+struct WorkloadConfig {
+  std::string mix = "buy";
+  long long books = 10000;
+  long long users = 1000;
+  long long commands = 100000;
+  unsigned long long seed = 1;
+};
+
+struct Workload {
+  // 建立书目与用户的命令，不计时。
+  std::vector<std::string> setup;
+  // 计时的命令，由若干次登录、操作、登出组成。
+  std::vector<std::string> commands;
+};
+
+// mix 不合法时抛出异常。
+Workload generateWorkload (const WorkloadConfig &config);
+
+#endif
@@ -1,7 +1,9 @@
 #!/bin/bash
 
-DATABASES=(author_books.dat books.dat keyword_books.dat name_books.dat users.dat log_cmd.bin log_trade.bin)
+DATABASES=(author_books.dat books.dat books.idx books.rec books.rows books_packed.idx books_packed.rec books_packed.rows books_strings.heap books_strings_dict.dat books_name_grams.dat books_author_grams.dat books_price.dat books_stock.dat keyword_books.dat name_books.dat author_books_covering.dat keyword_books_covering.dat name_books_covering.dat keyword_index.dat author_index.dat name_index.dat keyword_index_covering.dat author_index_covering.dat name_index_covering.dat users.dat users.idx users.rec users.rows log_cmd.bin log_cmd.log log_cmd_offset.bin log_trade.bin log_trade_sum.bin log_cmd_index.dat bookstore.wal bookstore.wal.old)
 
 for db in ${DATABASES[@]}; do rm -f $db; done
 
+rm -f log_*.seg
+
 rm -f data/*
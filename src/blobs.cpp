@@ -0,0 +1,43 @@
+#include "blobs.h"
+
+#include <algorithm>
+#include <exception>
+#include <filesystem>
+
+#include "cache.h"
+
+BlobFile::BlobFile (const char *filename) {
+  if (!std::filesystem::exists(filename)) std::ofstream(filename, std::ios::binary);
+  file_.open(filename, std::ios::in | std::ios::out | std::ios::binary);
+  if (!file_) throw std::exception();
+  file_.seekg(0, std::ios::end);
+  size_ = file_.tellg();
+  cacheId_ = PageCache::instance().attach(&file_);
+}
+BlobFile::~BlobFile () {
+  PageCache::instance().detach(cacheId_);
+}
+
+long long BlobFile::push (const std::string &blob) {
+  long long offset = size_;
+  put(offset, blob);
+  return offset;
+}
+void BlobFile::put (long long offset, const std::string &blob) {
+  auto length = static_cast<int>(blob.length());
+  PageCache::instance().write(cacheId_, offset, &length, sizeof(length));
+  PageCache::instance().write(cacheId_, offset + sizeof(length), blob.data(), length);
+  size_ = std::max<long long>(size_, offset + sizeof(length) + length);
+}
+
+std::string BlobFile::get (long long offset) {
+  int length = 0;
+  PageCache::instance().read(cacheId_, offset, &length, sizeof(length));
+  std::string blob(length, '\0');
+  PageCache::instance().read(cacheId_, offset + sizeof(length), blob.data(), length);
+  return blob;
+}
+
+long long BlobFile::size () const {
+  return size_;
+}
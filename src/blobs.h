@@ -0,0 +1,31 @@
+#ifndef PANIC_BOOKSTORE_BLOBS_H_
+#define PANIC_BOOKSTORE_BLOBS_H_
+
+#include <fstream>
+#include <string>
+
+// 只追加的变长记录文件，每条记录为 4 字节长度 + 内容。
+// 记录的位置（字节偏移量）由调用者自行保存，用于随机访问。
+// 读写都经过共享的 PageCache.
+class BlobFile {
+ private:
+  std::fstream file_;
+  int cacheId_;
+  long long size_ = 0;
+
+ public:
+  BlobFile () = delete;
+  BlobFile (const char *filename);
+  BlobFile (const BlobFile &) = delete;
+  BlobFile &operator= (const BlobFile &) = delete;
+  ~BlobFile ();
+  // 在文件末尾加入一条记录，返回其偏移量。
+  long long push (const std::string &blob);
+  // 在偏移量 offset 处写入一条记录，用于日志重放，必要时延长文件。
+  void put (long long offset, const std::string &blob);
+  // 读取偏移量为 offset 的记录。
+  std::string get (long long offset);
+  long long size () const;
+};
+
+#endif
@@ -4,30 +4,107 @@
 
 #include <ak/compare.h>
 #include <ak/validator.h>
-#include <iostream>
+#include <algorithm>
+#include <filesystem>
+#include <memory>
 #include <set>
 #include <sstream>
 #include <vector>
 
+#include "charset.h"
+#include "output.h"
+#include "parallel.h"
+#include "wal.h"
+
 bool Book::operator< (const Book &rhs) const {
   return isbn < rhs.isbn;
 }
+bool BookRecord::operator< (const BookRecord &rhs) const {
+  return isbn < rhs.isbn;
+}
 
 namespace {
 using ak::validator::expect;
+
+// 将 book 转换为紧凑记录。from/fromRecord 为同一本书修改前的内容与记录，
+// 没有变化的字符串沿用原来的偏移量，不再写入字符串堆。
+BookRecord pack (StringHeap &strings, const Book &book, const Book *from = nullptr, const BookRecord *fromRecord = nullptr) {
+  BookRecord record;
+  record.isbn = book.isbn;
+  record.price = book.price;
+  record.quantity = book.quantity;
+  if (from && from->author == book.author) {
+    record.author = fromRecord->author;
+  } else {
+    record.author = strings.intern(book.author.str());
+  }
+  if (from && from->name == book.name && from->keyword == book.keyword) {
+    record.text = fromRecord->text;
+  } else if (book.name.str().empty() && book.keyword.str().empty()) {
+    record.text = StringHeap::kEmpty;
+  } else {
+    record.text = strings.push(book.name.str() + '\t' + book.keyword.str());
+  }
+  return record;
+}
+Book unpack (StringHeap &strings, const BookRecord &record) {
+  Book book;
+  book.isbn = record.isbn;
+  book.author = strings.get(record.author);
+  std::string text = strings.get(record.text);
+  size_t tab = text.find('\t');
+  if (tab != std::string::npos) {
+    book.name = text.substr(0, tab);
+    book.keyword = text.substr(tab + 1);
+  }
+  book.price = record.price;
+  book.quantity = record.quantity;
+  return book;
+}
+
+// load 的一行，不合法时抛出异常。只 select 过的书输出时书名、作者与关键词为空，
+// 这三项可以为空，非空时与 modify 的检查相同；库存与一次 import 的上限相同。
+Book parseCatalogLine (const std::string &line) {
+  std::vector<std::string> fields;
+  std::istringstream iss(line);
+  for (std::string field; std::getline(iss, field, '\t'); ) fields.push_back(field);
+  if (!line.empty() && line.back() == '\t') fields.emplace_back();
+  if (fields.size() != 6) throw std::exception();
+  Book book;
+  if (fields[0].empty()) throw std::exception();
+  Book::validateIsbn(fields[0]);
+  if (!fields[1].empty()) Book::validateName(fields[1]);
+  if (!fields[2].empty()) Book::validateAuthor(fields[2]);
+  if (!fields[3].empty()) Book::validateKeyword(fields[3]);
+  book.isbn = fields[0];
+  book.name = fields[1];
+  book.author = fields[2];
+  book.keyword = fields[3];
+  book.price = Book::parseDecimal(fields[4]);
+  Book::validatePrice(book.price);
+  expect(fields[5]).toBeConsistedOf("1234567890").butNot().toBeLongerThan(10);
+  if (fields[5].empty()) throw std::exception();
+  book.quantity = std::stoll(fields[5]);
+  expect(book.quantity).Not().toBeGreaterThan(2'147'483'647LL);
+  return book;
+}
 } // namespace
 
 void Book::validateIsbn (const std::string &isbn) {
-  expect(isbn).toMatch(R"([\x21-\x7E]+)").butNot().toBeLongerThan(20);
+  charset::expectMatch(isbn, charset::kVisible);
+  expect(isbn).Not().toBeLongerThan(20);
 }
 void Book::validateName (const std::string &name) {
-  expect(name).toMatch(R"([\x21-\x7E]+)").butNot().toBeLongerThan(60).toInclude("\"");
+  charset::expectMatch(name, charset::kVisible);
+  expect(name).Not().toBeLongerThan(60).toInclude("\"");
 }
 void Book::validateAuthor (const std::string &author) {
-  expect(author).toMatch(R"([\x21-\x7E]+)").butNot().toBeLongerThan(60).toInclude("\"");
+  charset::expectMatch(author, charset::kVisible);
+  expect(author).Not().toBeLongerThan(60).toInclude("\"");
 }
 void Book::validateKeyword (const std::string &keyword) {
-  expect(keyword).toMatch(R"([\x21-\x7E]+)").butNot().toBeLongerThan(60).toInclude("\"");
+  charset::expectMatch(keyword, charset::kVisible);
+  expect(keyword).Not().toBeLongerThan(60).toInclude("\"");
   std::set<std::string> keywords;
   std::istringstream iss(keyword);
   while (!iss.eof()) {
@@ -53,14 +130,13 @@ long long Book::parseDecimal (const std::string &str) {
   return round(d * 100);
 }
 
-void Book::print () const {
-  std::cout
+void Book::print (Output &os) const {
+  os
     << isbn.str() << '\t'
     << name.str() << '\t'
     << author.str() << '\t'
-    << keyword.str() << '\t'
-    << formatDecimal(price) << '\t'
-    << quantity << '\n';
+    << keyword.str() << '\t';
+  os.decimal(price) << '\t' << quantity << '\n';
 }
 
 std::vector<std::string> Book::keywords() const {
@@ -80,30 +156,204 @@ BookManager::BookManager (
   const char *authorfile,
   const char *namefile
 ) :
-  books_(bookfile),
+  migrated_(migrate_(bookfile)),
+  strings_(std::string(bookfile) + "_strings"),
+  books_(std::string(bookfile) + "_packed"),
   keywordBooks_(keywordfile),
   authorBooks_(authorfile),
-  nameBooks_(namefile) {}
-std::optional<Book> BookManager::bookFromIsbn_ (const std::string &isbn) {
+  nameBooks_(namefile),
+  nameGrams_(std::string(bookfile) + "_name_grams.dat"),
+  authorGrams_(std::string(bookfile) + "_author_grams.dat"),
+  priceIndex_(std::string(bookfile) + "_price.dat"),
+  stockIndex_(std::string(bookfile) + "_stock.dat") {
+  // 旧版的数据文件可能缺少最后几条命令的修改，它们只在预写日志中，以旧表的名字记录。
+  if (migrated_) {
+    legacyWalId_ = Wal::instance().attach(bookfile, std::vector<std::string>(), [this] (char op, std::string_view key, std::string_view value) {
+      replayLegacy_(op, key, value);
+    });
+  }
+  Wal::instance().afterReplay([this] { rebuild_(); });
+}
+void BookManager::rebuild_ () {
+  if (
+    nameBooks_.existed() && authorBooks_.existed() && keywordBooks_.existed() &&
+    nameGrams_.existed() && authorGrams_.existed() && priceIndex_.existed() && stockIndex_.existed()
+  ) return;
+  // 重放可能已经写入了一部分项，先查再插，以免重复。
+  auto addMissing = [] (IndexTree &tree, const IndexKey &key, const IndexEntry &entry) {
+    if (!tree.find(key, entry)) tree.add(key, entry);
+  };
+  forEachBook_([this, &addMissing] (const Book &book) {
+    if (!nameBooks_.existed()) addMissing(nameBooks_, book.name, indexEntry_(book));
+    if (!authorBooks_.existed()) addMissing(authorBooks_, book.author, indexEntry_(book));
+    if (!keywordBooks_.existed()) for (const auto &kw : book.keywords()) addMissing(keywordBooks_, kw, indexEntry_(book));
+    if (!nameGrams_.existed()) nameGrams_.addMissing(book.name.str(), book.isbn);
+    if (!authorGrams_.existed()) authorGrams_.addMissing(book.author.str(), book.isbn);
+    if (!priceIndex_.existed()) priceIndex_.addMissing(book.price, book.isbn);
+    if (!stockIndex_.existed()) stockIndex_.addMissing(book.quantity, book.isbn);
+  });
+}
+BookManager::~BookManager () {
+  if (legacyWalId_ >= 0) Wal::instance().detach(legacyWalId_);
+}
+BookManager::IndexEntry BookManager::indexEntry_ (const Book &book) {
+#ifdef BOOKSTORE_COVERING_INDEX
+  return book;
+#else
+  return book.isbn;
+#endif
+}
+void BookManager::reindexQuantity_ (const BookRecord &from, const BookRecord &to) {
+  Book book = unpack(strings_, from);
+  Book copy = book;
+  copy.quantity = to.quantity;
+  reindex_(book, copy, { kAuthor, kKeyword, kName });
+}
+void BookManager::reindex_ (const Book &from, const Book &to, const std::set<Field> &fields) {
+  for (const Field &field : fields) {
+    if (field == kAuthor) {
+      authorBooks_.del(from.author, indexEntry_(from));
+      authorBooks_.add(to.author, indexEntry_(to));
+      authorGrams_.update(from.author.str(), from.isbn, to.author.str(), to.isbn);
+    }
+    if (field == kKeyword) {
+      for (const auto &kw : from.keywords()) keywordBooks_.del(kw, indexEntry_(from));
+      for (const auto &kw : to.keywords()) keywordBooks_.add(kw, indexEntry_(to));
+    }
+    if (field == kName) {
+      nameBooks_.del(from.name, indexEntry_(from));
+      nameBooks_.add(to.name, indexEntry_(to));
+      nameGrams_.update(from.name.str(), from.isbn, to.name.str(), to.isbn);
+    }
+    if (field == kPrice) priceIndex_.update(from.price, from.isbn, to.price, to.isbn);
+    // 修改 ISBN 时库存索引中的 ISBN 也要替换。
+    if (field == kIsbn) stockIndex_.update(from.quantity, from.isbn, to.quantity, to.isbn);
+  }
+}
+// 转换中断时旧表仍在，下次启动丢弃转换了一半的新文件重新开始。
+// 更早的版本把书直接存在 bookfile + ".dat" 的树中，由 Table 先转换为旧表。
+bool BookManager::migrate_ (const std::string &bookfile) {
+  if (!std::filesystem::exists(bookfile + ".idx") && !std::filesystem::exists(bookfile + ".dat")) return false;
+  for (const char *suffix : { "_packed.idx", "_packed.rows", "_packed.rec", "_strings.heap", "_strings_dict.dat" }) {
+    std::filesystem::remove(bookfile + suffix);
+  }
+  {
+    Table<ak::file::Varchar<20>, Book> legacy(bookfile);
+    StringHeap strings(bookfile + "_strings");
+    Table<ak::file::Varchar<20>, BookRecord> books(bookfile + "_packed");
+    legacy.forEach([&] (const Book &book) { books.add(book.isbn, pack(strings, book)); });
+  }
+  std::filesystem::remove(bookfile + ".idx");
+  std::filesystem::remove(bookfile + ".rows");
+  std::filesystem::remove(bookfile + ".rec");
+  return true;
+}
+void BookManager::replayLegacy_ (char op, std::string_view key, std::string_view value) {
+  auto isbn = Wal::as<ak::file::Varchar<20>>(key);
+  std::vector<BookRecord> old;
+  books_.query(isbn, old);
+  if (op == 'P') {
+    auto book = Wal::as<Book>(value);
+    if (old.empty()) {
+      books_.add(isbn, pack(strings_, book));
+    } else {
+      books_.update(isbn, old.front(), pack(strings_, book));
+    }
+  }
+  if (op == 'D' && !old.empty()) books_.del(isbn, old.front());
+}
+std::optional<BookRecord> BookManager::recordFromIsbn_ (const std::string &isbn) {
   Book::validateIsbn(isbn);
-  std::vector<Book> book;
-  books_.query(isbn, book);
-  if (book.empty()) return std::nullopt;
-  return book.front();
+  std::vector<BookRecord> record;
+  books_.query(isbn, record);
+  if (record.empty()) return std::nullopt;
+  return record.front();
+}
+std::optional<Book> BookManager::bookFromIsbn_ (const std::string &isbn) {
+  auto record = recordFromIsbn_(isbn);
+  if (!record) return std::nullopt;
+  return unpack(strings_, *record);
+}
+void BookManager::booksFromIsbns_ (const std::vector<ak::file::Varchar<20>> &isbns, std::vector<Book> &books) {
+  std::vector<BookRecord> records;
+  books_.queryBatch(isbns, records);
+  books.clear();
+  books.reserve(records.size());
+  for (const auto &record : records) books.push_back(unpack(strings_, record));
+}
+void BookManager::lockUntilCommit_ (std::initializer_list<std::string_view> isbns) {
+  auto latch = std::make_shared<LatchTable::Guard>(latches_.lock(isbns));
+  Wal::instance().afterCommit([latch] { *latch = LatchTable::Guard(); });
+}
+template <typename Fn>
+void BookManager::forEachBook_ (Fn fn) {
+  books_.forEach([this, &fn] (const BookRecord &record) { fn(unpack(strings_, record)); });
+}
+void BookManager::search_ (Field field, const std::string &value) {
+  bool byName = field == kNamePrefix || field == kNameContains;
+  bool prefix = field == kNamePrefix || field == kAuthorPrefix;
+  if (byName) {
+    Book::validateName(value);
+  } else {
+    Book::validateAuthor(value);
+  }
+  auto matches = [&] (const Book &book) {
+    std::string text = byName ? book.name.str() : book.author.str();
+    return prefix ? text.starts_with(value) : text.find(value) != std::string::npos;
+  };
+  std::vector<Book> books;
+  if (auto isbns = (byName ? nameGrams_ : authorGrams_).candidates(value, prefix)) {
+    booksFromIsbns_(*isbns, books);
+    std::erase_if(books, [&] (const Book &book) { return !matches(book); });
+  } else {
+    // 短于三个字节的子串无法用索引，只能扫描整个书本表。
+    forEachBook_([&] (const Book &book) { if (matches(book)) books.push_back(book); });
+  }
+  if (books.empty()) {
+    out() << '\n';
+    return;
+  }
+  formatParallel(books, out(), [] (size_t, const Book &book, Output &os) { book.print(os); });
+}
+void BookManager::showRange_ (RangeIndex &index, long long lo, long long hi, long long offset, long long limit) {
+  auto isbns = index.query(lo, hi, offset, limit);
+  if (isbns.empty()) {
+    out() << '\n';
+    return;
+  }
+  // 批量查询要求 ISBN 升序，查完再按索引给出的顺序输出。
+  auto sorted = isbns;
+  std::sort(sorted.begin(), sorted.end());
+  std::vector<Book> books;
+  booksFromIsbns_(sorted, books);
+  for (const auto &isbn : isbns) {
+    auto it = std::lower_bound(books.begin(), books.end(), isbn, [] (const Book &book, const auto &isbn) { return book.isbn < isbn; });
+    if (it != books.end() && it->isbn == isbn) it->print();
+  }
+}
+void BookManager::showPrice (long long lo, long long hi, long long offset, long long limit) {
+  showRange_(priceIndex_, lo, hi, offset, limit);
+}
+void BookManager::showStock (long long lo, long long hi, long long offset, long long limit) {
+  showRange_(stockIndex_, lo, hi, offset, limit);
 }
 void BookManager::show (Field field, const std::string &value) {
   if (value.length() == 0) throw std::exception();
+  if (field >= kNamePrefix) {
+    search_(field, value);
+    return;
+  }
   expect(field).toBeOneOf({ kIsbn, kKeyword, kAuthor, kName });
   if (field == kIsbn) {
     auto book = bookFromIsbn_(value);
     if (!book) {
-      std::cout << '\n';
+      out() << '\n';
       return;
     }
     book->print();
     return;
   }
-  BpTree<ak::file::Varchar<60>, ak::file::Varchar<20>> *db;
+  IndexTree *db;
   if (field == kKeyword) {
     db = &keywordBooks_;
     Book::validateKeyword(value);
@@ -117,87 +367,113 @@ void BookManager::show (Field field, const std::string &value) {
     Book::validateName(value);
     db = &nameBooks_;
   }
-  std::vector<ak::file::Varchar<20>> ids;
-  db->query(value, ids);
-  if (ids.empty()) {
-    std::cout << '\n';
+  std::vector<IndexEntry> entries;
+  db->query(value, entries);
+#ifdef BOOKSTORE_COVERING_INDEX
+  std::vector<Book> books = std::move(entries);
+#else
+  // 同一 key 下的 ISBN 已按升序排列，可以直接批量查询。
+  std::vector<Book> books;
+  booksFromIsbns_(entries, books);
+#endif
+  // 不同原文的 key 可能相同（见 IndexKey），按原文核对。
+  std::erase_if(books, [&] (const Book &book) {
+    if (field == kName) return book.name.str() != value;
+    if (field == kAuthor) return book.author.str() != value;
+    auto keywords = book.keywords();
+    return std::find(keywords.begin(), keywords.end(), value) == keywords.end();
+  });
+  if (books.empty()) {
+    out() << '\n';
     return;
   }
-  for (const auto &isbn : ids) {
-    bookFromIsbn_(isbn)->print();
-  }
+  for (const auto &book : books) book.print();
 }
 void BookManager::show () {
-  std::vector<std::pair<decltype(Book().isbn), Book>> res;
-  books_.queryAll(res);
-  if (res.empty()) {
-    std::cout << '\n';
-    return;
-  }
-  for (const auto &[ _, book ] : res) book.print();
+  bool empty = true;
+  BatchFormatter<Book> formatter(out(), [] (size_t, const Book &book, Output &os) { book.print(os); });
+  forEachBook_([&empty, &formatter] (const Book &book) {
+    empty = false;
+    formatter.push(book);
+  });
+  formatter.flush();
+  if (empty) out() << '\n';
 }
 long long BookManager::buy (const std::string &isbn, long long cnt) {
-  auto book = bookFromIsbn_(isbn);
-  if (!book) throw std::exception();
-  expect(cnt).Not().toBeGreaterThan(2'147'483'647LL).toBeGreaterThan(book->quantity);
+  Book::validateIsbn(isbn);
+  expect(cnt).Not().toBeGreaterThan(2'147'483'647LL);
 
-  // critical area begin
-  books_.del(book->isbn, *book);
-  book->quantity -= cnt;
-  books_.add(book->isbn, *book);
-  // critical area end
+  lockUntilCommit_({ isbn });
+  // 库存检查与扣减在同一次记录访问中完成，不会超卖。
+  BookRecord old, record;
+  bool sold = books_.modifyInPlace(isbn, [&] (BookRecord &r) {
+    if (cnt > r.quantity) return false;
+    old = r;
+    r.quantity -= cnt;
+    record = r;
+    return true;
+  });
+  if (!sold) throw std::exception();
+  if constexpr (kCoveringIndex) reindexQuantity_(old, record);
+  stockIndex_.update(old.quantity, old.isbn, record.quantity, record.isbn);
 
-  long long price = book->price * cnt;
-  std::cout << Book::formatDecimal(price) << '\n';
+  long long price = record.price * cnt;
+  out().decimal(price) << '\n';
   return price;
 }
 Book BookManager::select (const std::string &isbn) {
+  lockUntilCommit_({ isbn });
   auto book = bookFromIsbn_(isbn);
   if (book) return *book;
   Book::validateIsbn(isbn);
   Book b;
   b.isbn = isbn;
-  books_.add(b.isbn, b);
-  authorBooks_.add(b.author, b.isbn);
-  nameBooks_.add(b.name, b.isbn);
+  books_.add(b.isbn, pack(strings_, b));
+  authorBooks_.add(b.author, indexEntry_(b));
+  nameBooks_.add(b.name, indexEntry_(b));
+  priceIndex_.add(b.price, b.isbn);
+  stockIndex_.add(b.quantity, b.isbn);
   return b;
 }
 
 Book BookManager::modify (const std::string &isbn, const std::vector<FieldClause> &updates) {
   expect(updates.size()).toBeGreaterThan(0);
-  auto obook = bookFromIsbn_(isbn);
-  if (!obook) throw std::exception();
-  Book book = *obook;
+  // 修改 ISBN 时新旧两个 ISBN 一起锁住。
+  std::string_view target = isbn;
+  for (const auto &update : updates) if (update.field == kIsbn) target = update.payload;
+  lockUntilCommit_({ isbn, target });
+  auto record = recordFromIsbn_(isbn);
+  if (!record) throw std::exception();
+  Book book = unpack(strings_, *record);
   Book copy = book;
   std::set<Field> fieldsUpdated;
   for (const auto &update : updates) {
     if (update.payload.empty()) throw std::exception();
+    std::string payload(update.payload);
     switch (update.field) {
       case kIsbn: {
-        Book::validateIsbn(update.payload);
-        std::vector<Book> existing;
-        books_.query(update.payload, existing);
-        if (!existing.empty()) throw std::exception();
-        copy.isbn = update.payload;
+        Book::validateIsbn(payload);
+        if (books_.contains(payload)) throw std::exception();
+        copy.isbn = payload;
         break;
       }
       case kKeyword: {
-        Book::validateKeyword(update.payload);
-        copy.keyword = update.payload;
+        Book::validateKeyword(payload);
+        copy.keyword = payload;
         break;
       }
       case kAuthor: {
-        Book::validateAuthor(update.payload);
-        copy.author = update.payload;
+        Book::validateAuthor(payload);
+        copy.author = payload;
         break;
       }
       case kName: {
-        Book::validateName(update.payload);
-        copy.name = update.payload;
+        Book::validateName(payload);
+        copy.name = payload;
         break;
       }
       case kPrice: {
-        long long price = Book::parseDecimal(update.payload);
+        long long price = Book::parseDecimal(payload);
         Book::validatePrice(price);
         copy.price = price;
         break;
@@ -208,44 +484,99 @@ Book BookManager::modify (const std::string &isbn, const std::vector<FieldClause
     fieldsUpdated.insert(update.field);
   }
 
-  if (fieldsUpdated.contains(kIsbn)) {
+  // 覆盖索引中存有整本书，任何字段变化都要更新所有索引。
+  if (fieldsUpdated.contains(kIsbn) || kCoveringIndex) {
     fieldsUpdated.insert(kAuthor);
     fieldsUpdated.insert(kKeyword);
     fieldsUpdated.insert(kName);
+    fieldsUpdated.insert(kPrice);
   }
-  for (const Field &field : fieldsUpdated) {
-    if (field == kAuthor) {
-      authorBooks_.del(book.author, book.isbn);
-      authorBooks_.add(copy.author, copy.isbn);
-    }
-    if (field == kKeyword) {
-      for (const auto &kw : book.keywords()) keywordBooks_.del(kw, book.isbn);
-      for (const auto &kw : copy.keywords()) keywordBooks_.add(kw, copy.isbn);
-    }
-    if (field == kName) {
-      nameBooks_.del(book.name, book.isbn);
-      nameBooks_.add(copy.name, copy.isbn);
-    }
-  }
+  reindex_(book, copy, fieldsUpdated);
 
-  books_.del(book.isbn, book);
+  BookRecord packed = pack(strings_, copy, &book, &*record);
+  if (fieldsUpdated.contains(kIsbn)) {
+    books_.del(book.isbn, *record);
+    books_.add(copy.isbn, packed);
+  } else {
+    books_.update(book.isbn, *record, packed);
+  }
   book = copy;
-  books_.add(book.isbn, book);
   return book;
 }
 void BookManager::import (const std::string &isbn, long long qty) {
-  auto obook = bookFromIsbn_(isbn);
-  if (!obook) throw std::exception();
-  Book book = *obook;
+  Book::validateIsbn(isbn);
   expect(qty).Not().toBeGreaterThan(2'147'483'647LL);
-  books_.del(book.isbn, book);
-  book.quantity += qty;
-  books_.add(book.isbn, book);
+  lockUntilCommit_({ isbn });
+  BookRecord old, record;
+  bool found = books_.modifyInPlace(isbn, [&] (BookRecord &r) {
+    old = r;
+    r.quantity += qty;
+    record = r;
+    return true;
+  });
+  if (!found) throw std::exception();
+  if constexpr (kCoveringIndex) reindexQuantity_(old, record);
+  stockIndex_.update(old.quantity, old.isbn, record.quantity, record.isbn);
 }
 
-void BookManager::clearCache () {
-  books_.clearCache();
-  authorBooks_.clearCache();
-  keywordBooks_.clearCache();
-  nameBooks_.clearCache();
+// 新书的二级索引项先收集起来，按 key 排序后依次插入，相邻的插入落在相邻的叶子上。
+// libakcpp 的树没有自底向上建树的接口，这是在逐条插入下能做到的最好的顺序。
+void BookManager::loadBatch_ (std::vector<Book> &batch) {
+  // 同一 ISBN 以最后一行为准。
+  std::stable_sort(batch.begin(), batch.end());
+  std::vector<Book> books;
+  for (size_t i = 0; i < batch.size(); ++i) {
+    if (i + 1 < batch.size() && batch[i].isbn == batch[i + 1].isbn) continue;
+    books.push_back(batch[i]);
+  }
+  std::vector<std::pair<IndexKey, IndexEntry>> names, authors, keywords;
+  for (const auto &book : books) {
+    std::vector<BookRecord> old;
+    books_.query(book.isbn, old);
+    if (!old.empty()) {
+      Book from = unpack(strings_, old.front());
+      reindex_(from, book, { kAuthor, kKeyword, kName, kPrice });
+      stockIndex_.update(from.quantity, from.isbn, book.quantity, book.isbn);
+      books_.update(book.isbn, old.front(), pack(strings_, book, &from, &old.front()));
+      continue;
+    }
+    books_.add(book.isbn, pack(strings_, book));
+    names.emplace_back(book.name, indexEntry_(book));
+    authors.emplace_back(book.author, indexEntry_(book));
+    for (const auto &kw : book.keywords()) keywords.emplace_back(kw, indexEntry_(book));
+    nameGrams_.add(book.name.str(), book.isbn);
+    authorGrams_.add(book.author.str(), book.isbn);
+    priceIndex_.add(book.price, book.isbn);
+    stockIndex_.add(book.quantity, book.isbn);
+  }
+  std::sort(names.begin(), names.end());
+  std::sort(authors.begin(), authors.end());
+  std::sort(keywords.begin(), keywords.end());
+  for (const auto &[ key, entry ] : names) nameBooks_.add(key, entry);
+  for (const auto &[ key, entry ] : authors) authorBooks_.add(key, entry);
+  for (const auto &[ key, entry ] : keywords) keywordBooks_.add(key, entry);
+  Wal::instance().commit();
+}
+long long BookManager::load (std::istream &is, long long &skipped) {
+  long long loaded = 0;
+  skipped = 0;
+  std::vector<Book> batch;
+  for (std::string line; std::getline(is, line); ) {
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    if (line.empty()) continue;
+    try {
+      batch.push_back(parseCatalogLine(line));
+    } catch (...) {
+      ++skipped;
+      continue;
+    }
+    if (batch.size() == kLoadBatch) {
+      loaded += batch.size();
+      loadBatch_(batch);
+      batch.clear();
+    }
+  }
+  loaded += batch.size();
+  if (!batch.empty()) loadBatch_(batch);
+  return loaded;
 }
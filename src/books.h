@@ -2,11 +2,31 @@
 #define PANIC_BOOKSTORE_BOOKS_H_
 
 #include <ak/file/varchar.h>
+#include <initializer_list>
+#include <istream>
 #include <optional>
+#include <set>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <vector>
 
 #include "bptree.h"
+#include "heap.h"
+#include "indexkey.h"
+#include "latch.h"
+#include "output.h"
+#include "rangeindex.h"
+#include "search.h"
+#include "table.h"
+
+// 覆盖索引：二级索引直接存整本书，按作者、书名、关键词查询时不必再回表，
+// 代价是修改库存、价格等时要同步更新所有索引中的副本，以及更多的磁盘空间。
+#ifdef BOOKSTORE_COVERING_INDEX
+constexpr bool kCoveringIndex = true;
+#else
+constexpr bool kCoveringIndex = false;
+#endif
 
 class Book {
  public:
@@ -29,33 +49,103 @@ class Book {
   // 修改与进货等直接访问成员变量。
 
   std::vector<std::string> keywords () const;
-  void print () const;
+  void print (Output &os = out()) const;
+};
+
+// 书本表中实际存储的紧凑记录，约为整本 Book 的四分之一大小。
+// 书名与关键词以 '\t' 连接后存在字符串堆中，作者经字典去重，记录中只存偏移量。
+// 库存仍为 64 位：每次进货不超过 2^31 - 1，累计可以超过 32 位。
+struct BookRecord {
+  ak::file::Varchar<20> isbn;
+  long long author = StringHeap::kEmpty;
+  long long text = StringHeap::kEmpty;
+  long long price = 0;
+  long long quantity = 0;
+  bool operator< (const BookRecord &rhs) const;
 };
 
 class BookManager {
+ public:
+  // kNamePrefix 及之后的字段只用于 show 的前缀/子串查询。
+  enum Field { kIsbn, kKeyword, kAuthor, kName, kPrice, kNamePrefix, kNameContains, kAuthorPrefix, kAuthorContains };
+  // 二级索引中存的内容，普通模式下为 ISBN，覆盖索引模式下为整本书。
+  // Book 也按 ISBN 比较大小，所以两种模式下同一 key 的 value 顺序相同。
+  using IndexEntry = std::conditional_t<kCoveringIndex, Book, ak::file::Varchar<20>>;
+  using IndexTree = BpTree<IndexKey, IndexEntry>;
+
  private:
-  BpTree<ak::file::Varchar<20>, Book> books_;
-  BpTree<ak::file::Varchar<60>, ak::file::Varchar<20>> nameBooks_;
-  BpTree<ak::file::Varchar<60>, ak::file::Varchar<20>> keywordBooks_;
-  BpTree<ak::file::Varchar<60>, ak::file::Varchar<20>> authorBooks_;
+  // 旧版书本表（bookfile + ".idx"/".rows"，更早为 ".rec"）直接存整本 Book，是否已转换为紧凑记录。
+  bool migrated_;
+  // 文件名为 bookfile + "_strings.heap"/"_strings_dict.dat".
+  StringHeap strings_;
+  // 文件名为 bookfile + "_packed.idx"/"_packed.rows".
+  Table<ak::file::Varchar<20>, BookRecord> books_;
+  // 转换后旧表在预写日志中的记录（整本 Book）重放时转写到新表，见 replayLegacy_.
+  int legacyWalId_ = -1;
+  IndexTree nameBooks_;
+  IndexTree keywordBooks_;
+  IndexTree authorBooks_;
+  // 书名与作者的三元组索引，文件名为 bookfile + "_name_grams.dat"/"_author_grams.dat".
+  GramIndex nameGrams_;
+  GramIndex authorGrams_;
+  // 价格与库存的范围索引，文件名为 bookfile + "_price.dat"/"_stock.dat".
+  RangeIndex priceIndex_;
+  RangeIndex stockIndex_;
+  // 按 ISBN 的锁，修改一本书的命令从读出之前一直持有到提交之后，
+  // 因此同一本书的修改在预写日志中的顺序与实际顺序一致，不同书的 buy 可以同时进行。
+  LatchTable latches_;
 
+  static bool migrate_ (const std::string &bookfile);
+  // 锁住 isbns，当前命令提交后释放（见 Wal::afterCommit）。同一命令中只能调用一次。
+  void lockUntilCommit_ (std::initializer_list<std::string_view> isbns);
+  // 缺失的派生索引（书名、作者、关键词、三元组、价格、库存）从书本表重建，
+  // 在预写日志重放之后进行，此时书本表已是最新状态。重放可能已经向丢失的
+  // 索引写入了一部分项，所以只插入其中还没有的项。
+  void rebuild_ ();
+  void replayLegacy_ (char op, std::string_view key, std::string_view value);
+  std::optional<BookRecord> recordFromIsbn_ (const std::string &isbn);
   std::optional<Book> bookFromIsbn_ (const std::string &isbn);
+  // isbns 须已升序排列。
+  void booksFromIsbns_ (const std::vector<ak::file::Varchar<20>> &isbns, std::vector<Book> &books);
+  template <typename Fn>
+  void forEachBook_ (Fn fn);
+  static IndexEntry indexEntry_ (const Book &book);
+  // 将 fields 对应的二级索引中 from 的记录替换为 to 的记录。
+  void reindex_ (const Book &from, const Book &to, const std::set<Field> &fields);
+  // 覆盖索引模式下只有库存变化时更新各索引中的副本。
+  void reindexQuantity_ (const BookRecord &from, const BookRecord &to);
+  // 按书名或作者的前缀/子串查询。
+  void search_ (Field field, const std::string &value);
+  void showRange_ (RangeIndex &index, long long lo, long long hi, long long offset, long long limit);
+  // 导入一批书，见 load.
+  void loadBatch_ (std::vector<Book> &batch);
+
  public:
-  enum Field { kIsbn, kKeyword, kAuthor, kName, kPrice };
+  // payload 指向原始命令中的内容，只在处理该命令期间有效。
   struct FieldClause {
     Field field;
-    std::string payload;
+    std::string_view payload;
   };
   BookManager () = delete;
+  // bookfile 为书本表与其附属文件的文件名前缀。
   BookManager (const char *bookfile, const char *keywordfile, const char *authorfile, const char *namefile);
+  BookManager (const BookManager &) = delete;
+  BookManager &operator= (const BookManager &) = delete;
+  ~BookManager ();
   void show (Field field, const std::string &value);
   void show ();
+  // 价格（以分计）或库存在 [lo, hi] 内的书，按该数值、ISBN 排序，跳过 offset 本后最多输出 limit 本。
+  void showPrice (long long lo, long long hi, long long offset, long long limit);
+  void showStock (long long lo, long long hi, long long offset, long long limit);
   long long buy (const std::string &isbn, long long cnt);
   Book select (const std::string &isbn);
   Book modify (const std::string &isbn, const std::vector<FieldClause> &updates);
   void import (const std::string &isbn, long long qty);
-
-  void clearCache ();
+  // 批量导入书目，每行为 ISBN、书名、作者、关键词、价格、库存，以 '\t' 分隔（与 show 的输出相同）。
+  // 已有的书整条替换，因此中断后可以重新导入同一文件。不合法的行跳过并计入 skipped.
+  // 每 kLoadBatch 行为一次提交；不记录交易，也不加锁，只在启动时使用。
+  long long load (std::istream &is, long long &skipped);
+  static constexpr size_t kLoadBatch = 4096;
 };
 
 #endif
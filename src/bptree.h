@@ -2,31 +2,113 @@
 #define PANIC_BOOKSTORE_BPTREE_H_
 
 #include <ak/file/bptree.h>
+#include <filesystem>
+#include <mutex>
+#include <utility>
+#include <vector>
 
+#include "cache.h"
+#include "stats.h"
+#include "wal.h"
+
+// 树的缓存由 libakcpp 管理，这里登记到共享的 PageCache 中，
+// 由它决定何时写回与清空。每次访问按一个节点估算缓存占用。
+// logged 为 true 时修改会记入预写日志，由其他结构负责恢复的树（如 Table 的索引）应传 false.
+// libakcpp 的树在查询时也会修改缓存，所有访问都持有本树的锁；加锁顺序为先树后 PageCache.
 template <typename KeyType, typename ValueType, size_t szChunk = ak::file::kDefaultSzChunk>
 class BpTree {
  private:
+  bool existed_;
+  std::mutex mutex_;
   ak::file::BpTree<KeyType, ValueType, szChunk> store_;
+  int cacheId_;
+  int walId_ = -1;
+
+  // 日志重放：只在需要时插入或删除，保证幂等。
+  void replay_ (char op, std::string_view key, std::string_view value) {
+    auto k = Wal::as<KeyType>(key);
+    auto v = Wal::as<ValueType>(value);
+    std::lock_guard lock(mutex_);
+    bool exists = store_.includes(k, v);
+    if (op == 'A' && !exists) store_.insert(k, v);
+    if (op == 'D' && exists) store_.remove(k, v);
+    PageCache::instance().touch(cacheId_, szChunk, true);
+  }
+
  public:
   BpTree () = delete;
-  BpTree (const char *filename) : store_(filename) {}
+  BpTree (const char *filename, bool logged = true) :
+    existed_(std::filesystem::exists(filename)),
+    store_(filename),
+    // 只在没有命令执行时由 PageCache::commit() 调用，不加锁，以免与先树后缓存的顺序相反。
+    cacheId_(PageCache::instance().attachExternal([this] { store_.clearCache(); })) {
+    if (!logged) return;
+    walId_ = Wal::instance().attach(filename, { filename }, [this] (char op, std::string_view key, std::string_view value) {
+      replay_(op, key, value);
+    });
+  }
+  BpTree (const BpTree &) = delete;
+  BpTree &operator= (const BpTree &) = delete;
+  ~BpTree () {
+    PageCache::instance().detachExternal(cacheId_);
+    if (walId_ >= 0) Wal::instance().detach(walId_);
+  }
   void add (const KeyType &key, const ValueType &value) {
+    std::lock_guard lock(mutex_);
+    if (walId_ >= 0) Wal::instance().log(walId_, 'A', Wal::bytes(key), Wal::bytes(value));
+    PageCache::instance().touch(cacheId_, szChunk, true);
+    Stats::instance().add(Stats::kTreeDescents);
+    Stats::instance().add(Stats::kTreeInserts);
     store_.insert(key, value);
   }
   void del (const KeyType &key, const ValueType &value) {
+    std::lock_guard lock(mutex_);
+    if (walId_ >= 0) Wal::instance().log(walId_, 'D', Wal::bytes(key), Wal::bytes(value));
+    PageCache::instance().touch(cacheId_, szChunk, true);
+    Stats::instance().add(Stats::kTreeDescents);
+    Stats::instance().add(Stats::kTreeRemoves);
     store_.remove(key, value);
   }
+  // 构造时文件是否已存在。文件丢失时预写日志仍会重放其中一部分修改，
+  // 但树不完整，需要由调用者重建，所以这里只看文件本身。
+  bool existed () const {
+    return existed_;
+  }
   // 检查树中是否有 (key, value)
   bool find (const KeyType &key, const ValueType &value) {
+    std::lock_guard lock(mutex_);
+    PageCache::instance().touch(cacheId_, szChunk, false);
+    Stats::instance().add(Stats::kTreeDescents);
     return store_.includes(key, value);
   }
   void query (const KeyType &key, std::vector<ValueType> &result) {
+    std::lock_guard lock(mutex_);
+    PageCache::instance().touch(cacheId_, szChunk, false);
+    Stats::instance().add(Stats::kTreeDescents);
     result = store_.findMany(key);
   }
+  // 批量查询，keys 须已升序排列，结果按 key 的顺序依次追加到 result.
+  // libakcpp 没有提供叶子链表的游标，这里按顺序逐个下降：相邻的 key 落在
+  // 相邻的叶子上，路径上的节点都在缓存里，重复的 key 只查一次。
+  void queryBatch (const std::vector<KeyType> &keys, std::vector<ValueType> &result) {
+    std::lock_guard lock(mutex_);
+    result.clear();
+    PageCache::instance().touch(cacheId_, szChunk, false);
+    for (size_t i = 0; i < keys.size(); ++i) {
+      if (i > 0 && !(keys[i - 1] < keys[i])) continue;
+      Stats::instance().add(Stats::kTreeDescents);
+      auto values = store_.findMany(keys[i]);
+      result.insert(result.end(), values.begin(), values.end());
+    }
+  }
   void queryAll (std::vector<std::pair<KeyType, ValueType>> &result) {
+    std::lock_guard lock(mutex_);
+    Stats::instance().add(Stats::kTreeScans);
     result = store_.findAll();
+    PageCache::instance().touch(cacheId_, result.size() * sizeof(result[0]), false);
   }
   void clearCache () {
+    std::lock_guard lock(mutex_);
     store_.clearCache();
   }
 };
@@ -0,0 +1,204 @@
+#include "cache.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "stats.h"
+
+PageCache &PageCache::instance () {
+  static PageCache cache;
+  return cache;
+}
+
+long long PageCache::key_ (int file, long long index) {
+  return (static_cast<long long>(file) << 40) | index;
+}
+size_t PageCache::pageLimit_ () const {
+  // 外部缓存与页共用预算，但至少保留几页以免来回换页。
+  size_t used = std::min(externalCharge_, budget_);
+  return std::max<size_t>((budget_ - used) / kPageSize, 8);
+}
+
+void PageCache::setBudget (size_t bytes) {
+  std::lock_guard lock(mutex_);
+  budget_ = bytes;
+}
+size_t PageCache::budget () const {
+  return budget_;
+}
+
+void PageCache::writeBack_ (Page &page) {
+  if (!page.dirty) return;
+  std::fstream &file = *files_[page.file];
+  file.seekp(page.index * static_cast<long long>(kPageSize));
+  file.write(page.data.data(), page.length);
+  page.dirty = false;
+  Stats::instance().add(Stats::kCacheWritebacks);
+}
+
+size_t PageCache::victim_ () {
+  // 第一圈清除访问标记，第二圈如果还有干净页一定能找到。
+  for (size_t step = 0; step < 2 * pages_.size(); ++step) {
+    size_t frame = hand_;
+    Page &page = pages_[frame];
+    hand_ = (hand_ + 1) % pages_.size();
+    if (page.dirty) continue;
+    if (page.referenced) {
+      page.referenced = false;
+      continue;
+    }
+    return frame;
+  }
+  return pages_.size();
+}
+
+PageCache::Page &PageCache::page_ (int file, long long index) {
+  auto it = table_.find(key_(file, index));
+  if (it != table_.end()) {
+    Stats::instance().add(Stats::kCacheHits);
+    Page &page = pages_[it->second];
+    page.referenced = true;
+    return page;
+  }
+  Stats::instance().add(Stats::kCacheMisses);
+
+  size_t frame = pages_.size() < pageLimit_() ? pages_.size() : victim_();
+  if (frame == pages_.size()) {
+    pages_.emplace_back();
+  } else {
+    Page &victim = pages_[frame];
+    if (victim.file >= 0) {
+      table_.erase(key_(victim.file, victim.index));
+      Stats::instance().add(Stats::kCacheEvictions);
+    }
+  }
+
+  Page &page = pages_[frame];
+  page.file = file;
+  page.index = index;
+  page.dirty = false;
+  page.referenced = true;
+  std::fstream &stream = *files_[file];
+  stream.seekg(index * static_cast<long long>(kPageSize));
+  stream.read(page.data.data(), kPageSize);
+  page.length = stream.gcount();
+  stream.clear();
+  std::fill(page.data.begin() + page.length, page.data.end(), 0);
+  table_[key_(file, index)] = frame;
+  return page;
+}
+
+int PageCache::attach (std::fstream *file) {
+  std::lock_guard lock(mutex_);
+  files_.push_back(file);
+  return files_.size() - 1;
+}
+void PageCache::detach (int file) {
+  std::lock_guard lock(mutex_);
+  for (auto &page : pages_) {
+    if (page.file != file) continue;
+    writeBack_(page);
+    table_.erase(key_(page.file, page.index));
+    page.file = -1;
+    page.referenced = false;
+  }
+  files_[file]->flush();
+  files_[file] = nullptr;
+}
+
+void PageCache::read (int file, long long offset, void *buf, size_t size) {
+  std::lock_guard lock(mutex_);
+  auto *dest = static_cast<char *>(buf);
+  while (size > 0) {
+    Page &page = page_(file, offset / kPageSize);
+    size_t begin = offset % kPageSize;
+    size_t n = std::min(size, kPageSize - begin);
+    std::memcpy(dest, page.data.data() + begin, n);
+    dest += n;
+    offset += n;
+    size -= n;
+  }
+}
+void PageCache::write (int file, long long offset, const void *buf, size_t size) {
+  std::lock_guard lock(mutex_);
+  const auto *src = static_cast<const char *>(buf);
+  while (size > 0) {
+    Page &page = page_(file, offset / kPageSize);
+    size_t begin = offset % kPageSize;
+    size_t n = std::min(size, kPageSize - begin);
+    std::memcpy(page.data.data() + begin, src, n);
+    page.length = std::max(page.length, begin + n);
+    page.dirty = true;
+    src += n;
+    offset += n;
+    size -= n;
+  }
+}
+
+bool PageCache::clean (int file) {
+  std::lock_guard lock(mutex_);
+  for (auto &page : pages_) if (page.file == file && page.dirty) return false;
+  files_[file]->flush();
+  return true;
+}
+
+int PageCache::attachExternal (std::function<void ()> clear) {
+  std::lock_guard lock(mutex_);
+  int id = nextExternal_++;
+  External &ext = externals_[id];
+  ext.clear = std::move(clear);
+  ext.lru = externalLru_.insert(externalLru_.end(), id);
+  return id;
+}
+void PageCache::detachExternal (int id) {
+  std::lock_guard lock(mutex_);
+  auto it = externals_.find(id);
+  if (it == externals_.end()) return;
+  externalCharge_ -= it->second.charge;
+  externalLru_.erase(it->second.lru);
+  externals_.erase(it);
+}
+void PageCache::touch (int id, size_t charge, bool dirty) {
+  std::lock_guard lock(mutex_);
+  External &ext = externals_.at(id);
+  ext.charge += charge;
+  externalCharge_ += charge;
+  ext.dirty = ext.dirty || dirty;
+  externalLru_.splice(externalLru_.end(), externalLru_, ext.lru);
+}
+void PageCache::dropExternal_ (int id) {
+  External &ext = externals_.at(id);
+  ext.clear();
+  externalCharge_ -= ext.charge;
+  ext.charge = 0;
+  ext.dirty = false;
+}
+
+void PageCache::commit () {
+  std::lock_guard lock(mutex_);
+  // 按文件内的位置顺序写回，中途崩溃时只追加的文件（如分段日志）留下的是完整的前缀。
+  std::vector<Page *> dirty;
+  for (auto &page : pages_) if (page.file >= 0 && page.dirty) dirty.push_back(&page);
+  std::sort(dirty.begin(), dirty.end(), [] (const Page *lhs, const Page *rhs) {
+    return key_(lhs->file, lhs->index) < key_(rhs->file, rhs->index);
+  });
+  for (auto *page : dirty) writeBack_(*page);
+  for (auto *file : files_) if (file) file->flush();
+  for (auto &[ id, ext ] : externals_) {
+    if (!ext.dirty) continue;
+    dropExternal_(id);
+    Stats::instance().add(Stats::kCacheWritebacks);
+  }
+  for (auto it = externalLru_.begin(); it != externalLru_.end() && externalCharge_ > budget_; ++it) {
+    if (externals_.at(*it).charge == 0) continue;
+    dropExternal_(*it);
+    Stats::instance().add(Stats::kCacheEvictions);
+  }
+  // 都已是干净页，超出预算的部分直接丢弃。
+  while (pages_.size() > pageLimit_()) {
+    Page &page = pages_.back();
+    if (page.file >= 0) table_.erase(key_(page.file, page.index));
+    pages_.pop_back();
+  }
+  if (hand_ >= pages_.size()) hand_ = 0;
+}
@@ -0,0 +1,96 @@
+#ifndef PANIC_BOOKSTORE_CACHE_H_
+#define PANIC_BOOKSTORE_CACHE_H_
+
+#include <array>
+#include <cstddef>
+#include <fstream>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// 进程内共享的页缓存，所有存储文件共用同一个内存预算。
+//
+// 自己管理的文件（如 BlobFile）按页缓存，使用 CLOCK 算法淘汰干净页。
+// 脏页不会被淘汰，只在预写日志落盘后由 commit() 写回，因此数据文件不会领先于日志；
+// 一组命令写过的页都是脏页时，缓存暂时超出预算，写回后再缩回来。
+// libakcpp 的 BpTree/File 有自己的缓存，只能整体 clearCache()（写回并丢弃），
+// 因此以“外部缓存”的形式登记：按访问次数估算占用，本条命令中被写过的
+// 在命令结束时写回，只读的保持热状态，超出预算时按 LRU 顺序整体清空。
+//
+// 所有方法都可以在多个线程中同时调用。外部缓存的 clear 在持有本缓存的锁时调用，
+// 不能反过来访问本缓存；commit() 只能在没有命令执行时调用，此时清空外部缓存不会与访问冲突。
+class PageCache {
+ public:
+  static constexpr size_t kPageSize = 4096;
+  static constexpr size_t kDefaultBudget = 64 << 20;
+
+ private:
+  struct Page {
+    int file = -1;
+    long long index = 0;
+    size_t length = 0;  // 页内有效字节数，写回时只写这么多，避免把文件补零
+    bool dirty = false;
+    bool referenced = false;
+    std::array<char, kPageSize> data;
+  };
+  struct External {
+    std::function<void ()> clear;
+    size_t charge = 0;
+    bool dirty = false;
+    std::list<int>::iterator lru;
+  };
+
+  std::mutex mutex_;
+  size_t budget_ = kDefaultBudget;
+
+  std::vector<std::fstream *> files_;
+  std::vector<Page> pages_;
+  std::unordered_map<long long, size_t> table_;  // (file, index) -> pages_ 下标
+  size_t hand_ = 0;
+
+  std::unordered_map<int, External> externals_;
+  std::list<int> externalLru_;  // 最近访问的在末尾
+  size_t externalCharge_ = 0;
+  int nextExternal_ = 0;
+
+  PageCache () = default;
+  static long long key_ (int file, long long index);
+  size_t pageLimit_ () const;
+  void writeBack_ (Page &page);
+  // 按 CLOCK 找一个可以淘汰的干净页，没有时返回 pages_.size().
+  size_t victim_ ();
+  // 返回 (file, index) 所在页，不在缓存中则读入，必要时淘汰其他页。
+  Page &page_ (int file, long long index);
+  void dropExternal_ (int id);
+
+ public:
+  PageCache (const PageCache &) = delete;
+  PageCache &operator= (const PageCache &) = delete;
+  static PageCache &instance ();
+
+  void setBudget (size_t bytes);
+  size_t budget () const;
+
+  // 登记一个按页缓存的文件，返回其编号。
+  int attach (std::fstream *file);
+  // 写回并丢弃该文件的所有页。
+  void detach (int file);
+  void read (int file, long long offset, void *buf, size_t size);
+  void write (int file, long long offset, const void *buf, size_t size);
+  // 该文件没有未写回的页时，把已写回的内容刷到内核并返回 true，
+  // 之后直接映射或读取文件能看到最新内容。
+  bool clean (int file);
+
+  // 登记一个外部缓存，clear 为其写回并丢弃缓存的方法。
+  int attachExternal (std::function<void ()> clear);
+  void detachExternal (int id);
+  // 外部缓存的一次访问，charge 为估算新增的缓存字节数。
+  void touch (int id, size_t charge, bool dirty);
+
+  // 预写日志落盘后调用：写回所有脏页与被写过的外部缓存，并将页与外部缓存控制在预算内。
+  void commit ();
+};
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef PANIC_BOOKSTORE_CHARSET_H_
+#define PANIC_BOOKSTORE_CHARSET_H_
+
+#include <array>
+#include <exception>
+#include <string>
+#include <string_view>
+
+// 编译期生成的字符类，用查表代替正则表达式做输入检查。
+namespace charset {
+
+class CharClass {
+ private:
+  std::array<bool, 256> table_ {};
+
+ public:
+  constexpr CharClass () = default;
+  // 闭区间 [lo, hi] 内的字符。
+  static constexpr CharClass range (unsigned char lo, unsigned char hi) {
+    CharClass cls;
+    for (unsigned c = lo; c <= hi; ++c) cls.table_[c] = true;
+    return cls;
+  }
+  static constexpr CharClass of (std::string_view chars) {
+    CharClass cls;
+    for (char c : chars) cls.table_[static_cast<unsigned char>(c)] = true;
+    return cls;
+  }
+  constexpr CharClass operator| (const CharClass &rhs) const {
+    CharClass cls;
+    for (unsigned c = 0; c < 256; ++c) cls.table_[c] = table_[c] || rhs.table_[c];
+    return cls;
+  }
+  constexpr CharClass operator~ () const {
+    CharClass cls;
+    for (unsigned c = 0; c < 256; ++c) cls.table_[c] = !table_[c];
+    return cls;
+  }
+  constexpr bool contains (char c) const {
+    return table_[static_cast<unsigned char>(c)];
+  }
+  // 等价于正则表达式 [...]* 的完整匹配。
+  constexpr bool all (std::string_view str) const {
+    for (char c : str) if (!contains(c)) return false;
+    return true;
+  }
+  // 等价于正则表达式 [...]+ 的完整匹配。
+  constexpr bool matches (std::string_view str) const {
+    return !str.empty() && all(str);
+  }
+};
+
+// [\x21-\x7E]
+constexpr CharClass kVisible = CharClass::range(0x21, 0x7E);
+// [0-9]
+constexpr CharClass kDigit = CharClass::range('0', '9');
+// [0-9a-zA-Z_]
+constexpr CharClass kWord = CharClass::range('0', '9') | CharClass::range('a', 'z') | CharClass::range('A', 'Z') | CharClass::of("_");
+// 正则表达式中的 .，即除换行符以外的任意字符。
+constexpr CharClass kAny = ~CharClass::of("\n\r");
+
+// 检查 str 是否完整匹配 [cls]+，不匹配时抛出异常。
+inline void expectMatch (std::string_view str, const CharClass &cls) {
+  if (!cls.matches(str)) throw std::exception();
+}
+
+// 检查 str 是否完整匹配 prefix + [cls]+ + suffix，不匹配时抛出异常。
+inline void expectMatch (std::string_view str, std::string_view prefix, const CharClass &cls, std::string_view suffix = "") {
+  if (str.length() < prefix.length() + suffix.length()) throw std::exception();
+  if (!str.starts_with(prefix) || !str.ends_with(suffix)) throw std::exception();
+  expectMatch(str.substr(prefix.length(), str.length() - prefix.length() - suffix.length()), cls);
+}
+
+} // namespace charset
+
+#endif
@@ -0,0 +1,361 @@
+#include "commands.h"
+
+#include <ak/validator.h>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <climits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "charset.h"
+#include "output.h"
+#include "stats.h"
+
+namespace {
+
+BookManager::FieldClause parseClause (std::string_view arg) {
+  if (arg.length() < 2) throw std::exception();
+  if (arg[1] == 'I') {
+    charset::expectMatch(arg, "-ISBN=", charset::kAny);
+    return { .field = BookManager::Field::kIsbn, .payload = arg.substr(6) };
+  }
+  if (arg.starts_with("-name-prefix=")) {
+    charset::expectMatch(arg, "-name-prefix=\"", charset::kAny, "\"");
+    return { .field = BookManager::Field::kNamePrefix, .payload = arg.substr(14, arg.length() - 15) };
+  }
+  if (arg.starts_with("-name-contains=")) {
+    charset::expectMatch(arg, "-name-contains=\"", charset::kAny, "\"");
+    return { .field = BookManager::Field::kNameContains, .payload = arg.substr(16, arg.length() - 17) };
+  }
+  if (arg.starts_with("-author-prefix=")) {
+    charset::expectMatch(arg, "-author-prefix=\"", charset::kAny, "\"");
+    return { .field = BookManager::Field::kAuthorPrefix, .payload = arg.substr(16, arg.length() - 17) };
+  }
+  if (arg.starts_with("-author-contains=")) {
+    charset::expectMatch(arg, "-author-contains=\"", charset::kAny, "\"");
+    return { .field = BookManager::Field::kAuthorContains, .payload = arg.substr(18, arg.length() - 19) };
+  }
+  if (arg[1] == 'n') {
+    charset::expectMatch(arg, "-name=\"", charset::kAny, "\"");
+    return { .field = BookManager::Field::kName, .payload = arg.substr(7, arg.length() - 8) };
+  }
+  if (arg[1] == 'a') {
+    charset::expectMatch(arg, "-author=\"", charset::kAny, "\"");
+    return { .field = BookManager::Field::kAuthor, .payload = arg.substr(9, arg.length() - 10) };
+  }
+  if (arg[1] == 'k') {
+    charset::expectMatch(arg, "-keyword=\"", charset::kAny, "\"");
+    return { .field = BookManager::Field::kKeyword, .payload = arg.substr(10, arg.length() - 11) };
+  }
+  if (arg[1] == 'p') {
+    charset::expectMatch(arg, "-price=", charset::kAny);
+    return { .field = BookManager::Field::kPrice, .payload = arg.substr(7) };
+  }
+  throw std::exception();
+};
+
+// 不超过 10 位的非负整数。
+long long parseCount (std::string_view arg) {
+  charset::expectMatch(arg, charset::kDigit);
+  if (arg.length() > 10) throw std::exception();
+  long long count = 0;
+  std::from_chars(arg.data(), arg.data() + arg.length(), count);
+  return count;
+}
+
+// 按空格切分命令，结果为指向 line 的视图，tokens 在命令之间复用以免重复分配。
+void tokenize (std::string_view line, std::vector<std::string_view> &tokens) {
+  tokens.clear();
+  size_t begin = 0;
+  while (begin < line.length()) {
+    size_t end = line.find(' ', begin);
+    if (end == std::string_view::npos) end = line.length();
+    if (end > begin) tokens.push_back(line.substr(begin, end - begin));
+    begin = end + 1;
+  }
+}
+
+enum class Verb { kUnknown, kQuit, kSu, kLogout, kRegister, kPasswd, kUseradd, kDelete, kShow, kBuy, kSelect, kModify, kImport, kReport, kLog, kStats };
+constexpr const char *kVerbNames[] = { "unknown", "quit", "su", "logout", "register", "passwd", "useradd", "delete", "show", "buy", "select", "modify", "import", "report", "log", "stats" };
+
+// 先按首字母分派，每个分支只需比较一两次。
+Verb parseVerb (std::string_view verb) {
+  if (verb.empty()) return Verb::kUnknown;
+  switch (verb[0]) {
+    case 'b': if (verb == "buy") return Verb::kBuy; break;
+    case 'd': if (verb == "delete") return Verb::kDelete; break;
+    case 'e': if (verb == "exit") return Verb::kQuit; break;
+    case 'i': if (verb == "import") return Verb::kImport; break;
+    case 'l':
+      if (verb == "log") return Verb::kLog;
+      if (verb == "logout") return Verb::kLogout;
+      break;
+    case 'm': if (verb == "modify") return Verb::kModify; break;
+    case 'p': if (verb == "passwd") return Verb::kPasswd; break;
+    case 'q': if (verb == "quit") return Verb::kQuit; break;
+    case 'r':
+      if (verb == "report") return Verb::kReport;
+      if (verb == "register") return Verb::kRegister;
+      break;
+    case 's':
+      if (verb == "su") return Verb::kSu;
+      if (verb == "show") return Verb::kShow;
+      if (verb == "select") return Verb::kSelect;
+      if (verb == "stats") return Verb::kStats;
+      break;
+    case 'u': if (verb == "useradd") return Verb::kUseradd; break;
+    default: break;
+  }
+  return Verb::kUnknown;
+}
+
+// 记录从构造到析构的时间，命令以任何方式结束都会计入。
+class CommandTimer {
+ private:
+  Histogram &histogram_;
+  std::chrono::steady_clock::time_point begin_;
+
+ public:
+  explicit CommandTimer (Verb verb) : histogram_(histogramOf_(verb)), begin_(std::chrono::steady_clock::now()) {}
+  ~CommandTimer () {
+    histogram_.record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin_).count());
+  }
+
+ private:
+  // 各类命令的直方图只在第一次使用时查找。
+  static Histogram &histogramOf_ (Verb verb) {
+    static auto histograms = [] {
+      std::array<Histogram *, std::size(kVerbNames)> histograms;
+      for (size_t i = 0; i < histograms.size(); ++i) histograms[i] = &Stats::instance().command(kVerbNames[i]);
+      return histograms;
+    }();
+    return *histograms[static_cast<size_t>(verb)];
+  }
+};
+
+} // namespace
+
+bool concurrent (const std::string &rawCommand) {
+  std::string_view line = rawCommand;
+  size_t begin = line.find_first_not_of(' ');
+  if (begin == std::string_view::npos) return true;
+  line.remove_prefix(begin);
+  switch (parseVerb(line.substr(0, line.find(' ')))) {
+    case Verb::kQuit:
+    case Verb::kSu:
+    case Verb::kLogout:
+    case Verb::kShow:
+    case Verb::kBuy:
+    case Verb::kReport:
+    case Verb::kLog:
+    case Verb::kStats:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool execute (const std::string &rawCommand, BookManager &bookManager, UserManager &userManager, LogManager &logManager) {
+  thread_local std::vector<std::string_view> args;
+  if (rawCommand.size() > 1024) {
+    Stats::instance().add(Stats::kInvalidCommands);
+    out() << "Invalid\n";
+    return true;
+  }
+  if (rawCommand.empty()) return true;
+  tokenize(rawCommand, args);
+  if (args.empty()) return true;
+  Verb verb = parseVerb(args[0]);
+  CommandTimer timer(verb);
+  logManager.addLog(CmdRecord(userManager.currentUser().id(), rawCommand));
+  auto nary = [] (int i) { if (args.size() != i + 1) throw std::exception(); };
+  auto arg = [] (int i) { return std::string(args[i]); };
+  try {
+    switch (verb) {
+      case Verb::kQuit: {
+        nary(0);
+        return false;
+      }
+      case Verb::kSu: {
+        if (args.size() == 2) {
+          userManager.logIn(arg(1));
+        } else if (args.size() == 3) {
+          userManager.logIn(arg(1), arg(2));
+        } else {
+          throw std::exception();
+        }
+        break;
+      }
+      case Verb::kLogout: {
+        nary(0);
+        userManager.requestPrivilege(kCustomer);
+        userManager.logOut();
+        break;
+      }
+      case Verb::kRegister: {
+        nary(3);
+        userManager.signUp(arg(1), arg(2), arg(3));
+        break;
+      }
+      case Verb::kPasswd: {
+        userManager.requestPrivilege(kCustomer);
+        if (args.size() == 3) {
+          userManager.requestPrivilege(kRoot);
+          userManager.passwd(arg(1), arg(2));
+        } else if (args.size() == 4) {
+          userManager.passwd(arg(1), arg(2), arg(3));
+        } else {
+          throw std::exception();
+        }
+        break;
+      }
+      case Verb::kUseradd: {
+        nary(4);
+        userManager.requestPrivilege(kWorker);
+        Privilege p;
+        if (args[3] == "1") {
+          p = kCustomer;
+          userManager.requestPrivilege(kWorker);
+        } else if (args[3] == "3") {
+          p = kWorker;
+          userManager.requestPrivilege(kRoot);
+        } else {
+          throw std::exception();
+        }
+        userManager.userAdd(arg(1), arg(2), p, arg(4));
+        break;
+      }
+      case Verb::kDelete: {
+        nary(1);
+        userManager.requestPrivilege(kRoot);
+        userManager.remove(arg(1));
+        break;
+      }
+      case Verb::kShow: {
+        if (args.size() > 1 && args[1] == "finance") {
+          userManager.requestPrivilege(kRoot);
+          if (args.size() == 2) {
+            logManager.showFinance();
+          } else if (args.size() == 3) {
+            long long time = parseCount(args[2]);
+            ak::validator::expect(time).Not().toBeGreaterThan(2'147'483'647LL);
+            logManager.showFinance(time);
+          } else {
+            throw std::exception();
+          }
+        } else if (args.size() > 1 && (args[1] == "price" || args[1] == "stock")) {
+          // show price|stock <lo> <hi> [<limit> [<offset>]]
+          // 代价与覆盖到的桶的大小及 offset 成正比，见 RangeIndex.
+          bool byPrice = args[1] == "price";
+          userManager.requestPrivilege(byPrice ? kCustomer : kWorker);
+          if (args.size() < 4 || args.size() > 6) throw std::exception();
+          long long lo = byPrice ? Book::parseDecimal(arg(2)) : parseCount(args[2]);
+          long long hi = byPrice ? Book::parseDecimal(arg(3)) : parseCount(args[3]);
+          long long limit = args.size() > 4 ? parseCount(args[4]) : LLONG_MAX;
+          long long offset = args.size() > 5 ? parseCount(args[5]) : 0;
+          if (byPrice) {
+            bookManager.showPrice(lo, hi, offset, limit);
+          } else {
+            bookManager.showStock(lo, hi, offset, limit);
+          }
+        } else {
+          userManager.requestPrivilege(kCustomer);
+          if (args.size() == 1) {
+            bookManager.show();
+          } else if (args.size() == 2) {
+            BookManager::FieldClause clause = parseClause(args[1]);
+            if (clause.field == BookManager::Field::kPrice) throw std::exception();
+            bookManager.show(clause.field, std::string(clause.payload));
+          } else {
+            throw std::exception();
+          }
+        }
+        break;
+      }
+      case Verb::kBuy: {
+        nary(2);
+        userManager.requestPrivilege(kCustomer);
+        long long qty = parseCount(args[2]);
+        long long price = bookManager.buy(arg(1), qty);
+        logManager.addTrade(TradeRecord(false, price));
+        break;
+      }
+      case Verb::kSelect: {
+        nary(1);
+        userManager.requestPrivilege(kWorker);
+        Book book = bookManager.select(arg(1));
+        userManager.selection() = book.isbn;
+        break;
+      }
+      case Verb::kModify: {
+        ak::validator::expect(args.size()).toBeGreaterThan(1);
+        userManager.requestPrivilege(kWorker);
+        std::string isbn = userManager.selection();
+        if (isbn.empty()) throw std::exception();
+        std::vector<BookManager::FieldClause> updates;
+        bool updateIsbn = false;
+        for (int i = 1; i < args.size(); ++i) {
+          auto update = parseClause(args[i]);
+          if (update.field == BookManager::Field::kIsbn) updateIsbn = true;
+          updates.push_back(update);
+        }
+        Book book = bookManager.modify(isbn, updates);
+        if (updateIsbn) userManager.updateSeletions(isbn, book.isbn);
+        break;
+      }
+      case Verb::kImport: {
+        nary(2);
+        userManager.requestPrivilege(kWorker);
+        std::string isbn = userManager.selection();
+        if (isbn.empty()) throw std::exception();
+        long long qty = parseCount(args[1]);
+        long long totalCost = Book::parseDecimal(arg(2));
+        bookManager.import(isbn, qty);
+        logManager.addTrade(TradeRecord(true, totalCost));
+        break;
+      }
+      case Verb::kReport: {
+        nary(1);
+        if (args[1] != "myself" && args[1] != "finance" && args[1] != "employee") throw std::exception();
+        userManager.requestPrivilege(args[1] == "myself" ? kWorker : kRoot);
+        if (args[1] == "myself") {
+          logManager.reportEmployee(userManager.currentUser().id());
+        } else if (args[1] == "finance") {
+          logManager.reportFinance();
+        } else if (args[1] == "employee") {
+          userManager.forEachUser([&logManager] (const User &user) {
+            if (user.privilege() >= kWorker) {
+              logManager.reportEmployee(user.id());
+              out() << '\n';
+            }
+          });
+        }
+        break;
+      }
+      case Verb::kLog: {
+        nary(0);
+        userManager.requestPrivilege(kRoot);
+        logManager.reportLog();
+        break;
+      }
+      case Verb::kStats: {
+        userManager.requestPrivilege(kRoot);
+        if (args.size() == 1) {
+          Stats::instance().print(out());
+        } else if (args.size() == 2 && args[1] == "reset") {
+          Stats::instance().reset();
+        } else {
+          throw std::exception();
+        }
+        break;
+      }
+      default: throw std::exception();
+    }
+  } catch (...) {
+    Stats::instance().add(Stats::kInvalidCommands);
+    out() << "Invalid\n";
+  }
+  return true;
+}
@@ -0,0 +1,19 @@
+#ifndef PANIC_BOOKSTORE_COMMANDS_H_
+#define PANIC_BOOKSTORE_COMMANDS_H_
+
+#include <string>
+
+#include "books.h"
+#include "logs.h"
+#include "users.h"
+
+// 在 userManager 的当前终端中执行一条命令，输出写到 out().
+// 返回 false 表示该终端退出（quit/exit）。
+// 调用者负责在命令之间写回输出并提交预写日志。
+bool execute (const std::string &rawCommand, BookManager &bookManager, UserManager &userManager, LogManager &logManager);
+// 命令是否可以与其他这样的命令同时执行：除了记录自身（见 LogManager::addLog）以外
+// 只读取各存储、只修改当前终端的命令，以及按 ISBN 加锁、只修改一本书的 buy.
+// 只看命令名，不检查参数。
+bool concurrent (const std::string &rawCommand);
+
+#endif
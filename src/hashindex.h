@@ -0,0 +1,77 @@
+#ifndef PANIC_BOOKSTORE_HASHINDEX_H_
+#define PANIC_BOOKSTORE_HASHINDEX_H_
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// 内存中的开放寻址（线性探测）哈希表，从 key 映射到记录编号。
+// 记录编号须为正数，0 表示空位，-1 表示已删除。
+template <typename KeyType>
+class HashIndex {
+ private:
+  static constexpr int kEmpty = 0;
+  static constexpr int kDeleted = -1;
+  struct Bucket {
+    KeyType key;
+    int slot = kEmpty;
+  };
+  std::vector<Bucket> buckets_;
+  size_t size_ = 0;
+  size_t used_ = 0;  // 包括已删除的位置
+
+  static size_t hash_ (const KeyType &key) {
+    return std::hash<std::string>()(key);
+  }
+  // 返回 key 所在的位置，不存在时返回探测路径上第一个可用的位置。
+  size_t probe_ (const KeyType &key) const {
+    size_t mask = buckets_.size() - 1;
+    size_t i = hash_(key) & mask;
+    size_t firstFree = buckets_.size();
+    while (buckets_[i].slot != kEmpty) {
+      if (buckets_[i].slot == kDeleted) {
+        if (firstFree == buckets_.size()) firstFree = i;
+      } else if (buckets_[i].key == key) {
+        return i;
+      }
+      i = (i + 1) & mask;
+    }
+    return firstFree == buckets_.size() ? i : firstFree;
+  }
+  void rehash_ (size_t capacity) {
+    std::vector<Bucket> old(capacity);
+    old.swap(buckets_);
+    size_ = used_ = 0;
+    for (const auto &bucket : old) if (bucket.slot > 0) insert(bucket.key, bucket.slot);
+  }
+
+ public:
+  HashIndex () : buckets_(16) {}
+  // 返回 key 对应的记录编号，不存在时返回 0.
+  int find (const KeyType &key) const {
+    const Bucket &bucket = buckets_[probe_(key)];
+    return bucket.slot > 0 ? bucket.slot : 0;
+  }
+  void insert (const KeyType &key, int slot) {
+    // 负载因子（含已删除位置）不超过 1/2.
+    if ((used_ + 1) * 2 > buckets_.size()) rehash_(size_ * 4 > buckets_.size() ? buckets_.size() * 2 : buckets_.size());
+    Bucket &bucket = buckets_[probe_(key)];
+    if (bucket.slot <= 0) {
+      ++size_;
+      if (bucket.slot == kEmpty) ++used_;
+    }
+    bucket.key = key;
+    bucket.slot = slot;
+  }
+  void erase (const KeyType &key) {
+    Bucket &bucket = buckets_[probe_(key)];
+    if (bucket.slot <= 0) return;
+    bucket.slot = kDeleted;
+    --size_;
+  }
+  size_t size () const {
+    return size_;
+  }
+};
+
+#endif
@@ -0,0 +1,36 @@
+#include "heap.h"
+
+#include <vector>
+
+#include "wal.h"
+
+StringHeap::StringHeap (const std::string &name) :
+  blobs_((name + ".heap").c_str()),
+  walId_(Wal::instance().attach(name + ".heap", { name + ".heap" }, [this] (char op, std::string_view key, std::string_view value) {
+    if (op == 'W') blobs_.put(Wal::as<long long>(key), std::string(value));
+  })),
+  dictionary_((name + "_dict.dat").c_str()) {}
+StringHeap::~StringHeap () {
+  Wal::instance().detach(walId_);
+}
+
+long long StringHeap::push (const std::string &str) {
+  if (str.empty()) return kEmpty;
+  long long offset = blobs_.size();
+  Wal::instance().log(walId_, 'W', Wal::bytes(offset), str);
+  blobs_.put(offset, str);
+  return offset;
+}
+long long StringHeap::intern (const std::string &str) {
+  if (str.empty()) return kEmpty;
+  std::vector<long long> offsets;
+  dictionary_.query(str, offsets);
+  if (!offsets.empty()) return offsets.front();
+  long long offset = push(str);
+  dictionary_.add(str, offset);
+  return offset;
+}
+std::string StringHeap::get (long long offset) {
+  if (offset == kEmpty) return "";
+  return blobs_.get(offset);
+}
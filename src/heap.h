@@ -0,0 +1,38 @@
+#ifndef PANIC_BOOKSTORE_HEAP_H_
+#define PANIC_BOOKSTORE_HEAP_H_
+
+#include <ak/file/varchar.h>
+#include <string>
+
+#include "blobs.h"
+#include "bptree.h"
+
+// 存放变长字符串的堆文件，字符串以其在文件中的偏移量引用，kEmpty 表示空串。
+// 只追加：修改时写入新的字符串，旧的不回收。
+// 每次写入以（偏移量，内容）记入预写日志，重放时写回原位置，因此是幂等的；
+// 崩溃前未提交的写入只会在文件末尾留下没有引用的空间。
+// intern() 对相同的字符串只存一份，字典为 字符串 -> 偏移量 的 B+ 树。
+class StringHeap {
+ public:
+  static constexpr long long kEmpty = -1;
+
+ private:
+  BlobFile blobs_;
+  int walId_;
+  BpTree<ak::file::Varchar<60>, long long> dictionary_;
+
+ public:
+  StringHeap () = delete;
+  // 文件名为 name + ".heap" 与 name + "_dict.dat".
+  explicit StringHeap (const std::string &name);
+  StringHeap (const StringHeap &) = delete;
+  StringHeap &operator= (const StringHeap &) = delete;
+  ~StringHeap ();
+
+  long long push (const std::string &str);
+  // str 不长于 60 字节。
+  long long intern (const std::string &str);
+  std::string get (long long offset);
+};
+
+#endif
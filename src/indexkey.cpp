@@ -0,0 +1,17 @@
+#include "indexkey.h"
+
+IndexKey::IndexKey (std::string_view text) : hash(14695981039346656037ull) {
+  for (size_t i = 0; i < 8; ++i) {
+    prefix = prefix << 8 | (i < text.length() ? static_cast<unsigned char>(text[i]) : 0);
+  }
+  for (char ch : text) hash = (hash ^ static_cast<unsigned char>(ch)) * 1099511628211ull;
+}
+IndexKey::IndexKey (const std::string &text) : IndexKey(std::string_view(text)) {}
+
+bool IndexKey::operator< (const IndexKey &rhs) const {
+  if (prefix != rhs.prefix) return prefix < rhs.prefix;
+  return hash < rhs.hash;
+}
+bool IndexKey::operator== (const IndexKey &rhs) const {
+  return prefix == rhs.prefix && hash == rhs.hash;
+}
@@ -0,0 +1,27 @@
+#ifndef PANIC_BOOKSTORE_INDEXKEY_H_
+#define PANIC_BOOKSTORE_INDEXKEY_H_
+
+#include <ak/file/varchar.h>
+#include <string>
+#include <string_view>
+
+// 书名、作者、关键词索引的定长 key（"normalized key"）：原文前 8 个字节按大端序拼成的整数，
+// 加上整个原文的 64 位 FNV-1a 哈希，共 16 字节，取代 61 字节的 Varchar<60>.
+// 节点内的比较只是两次整数比较，同样大小的节点能放下更多的 key.
+// 这些索引只做等值查询，不需要按原文排序；按前缀排序让前缀相同的 key 落在相邻的叶子上。
+// 哈希碰撞时不同原文的 key 相同，查询结果需要由调用者按原文核对。
+struct IndexKey {
+  unsigned long long prefix = 0;
+  unsigned long long hash = 0;
+
+  IndexKey () = default;
+  IndexKey (std::string_view text);
+  IndexKey (const std::string &text);
+  template <size_t maxLength>
+  IndexKey (const ak::file::Varchar<maxLength> &text) : IndexKey(text.str()) {}
+
+  bool operator< (const IndexKey &rhs) const;
+  bool operator== (const IndexKey &rhs) const;
+};
+
+#endif
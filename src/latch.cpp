@@ -0,0 +1,18 @@
+#include "latch.h"
+
+#include <algorithm>
+#include <functional>
+
+size_t LatchTable::stripe_ (std::string_view key) {
+  return std::hash<std::string_view>()(key) % kStripes;
+}
+
+LatchTable::Guard LatchTable::lock (std::initializer_list<std::string_view> keys) {
+  std::vector<size_t> stripes;
+  for (auto key : keys) stripes.push_back(stripe_(key));
+  std::sort(stripes.begin(), stripes.end());
+  stripes.erase(std::unique(stripes.begin(), stripes.end()), stripes.end());
+  Guard guard;
+  for (size_t stripe : stripes) guard.locks_.emplace_back(latches_[stripe]);
+  return guard;
+}
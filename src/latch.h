@@ -0,0 +1,41 @@
+#ifndef PANIC_BOOKSTORE_LATCH_H_
+#define PANIC_BOOKSTORE_LATCH_H_
+
+#include <array>
+#include <initializer_list>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+// 按 key 分段的短期锁（latch）：同一 key 总是映射到同一把锁，不同的 key 大多落在不同的锁上，
+// 用来保护针对单条记录的“读出、检查、写回”。同时需要多个 key 时一次性按下标顺序加锁，避免死锁。
+class LatchTable {
+ public:
+  static constexpr size_t kStripes = 64;
+
+  // 析构时释放持有的所有锁。
+  class Guard {
+   private:
+    std::vector<std::unique_lock<std::mutex>> locks_;
+    friend class LatchTable;
+
+   public:
+    Guard () = default;
+    Guard (Guard &&) = default;
+    Guard &operator= (Guard &&) = default;
+  };
+
+ private:
+  std::array<std::mutex, kStripes> latches_;
+
+  static size_t stripe_ (std::string_view key);
+
+ public:
+  LatchTable () = default;
+  LatchTable (const LatchTable &) = delete;
+  LatchTable &operator= (const LatchTable &) = delete;
+
+  Guard lock (std::initializer_list<std::string_view> keys);
+};
+
+#endif
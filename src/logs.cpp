@@ -1,10 +1,13 @@
 #include "logs.h"
 
-#include <ak/chalk.h>
-#include <sstream>
-#include <iostream>
+#include <filesystem>
+#include <string_view>
+#include <vector>
 
 #include "books.h"
+#include "cache.h"
+#include "output.h"
+#include "parallel.h"
 
 TradeRecord::TradeRecord (const bool &isExpense, long long amount) : isExpense_(isExpense) {
   (isExpense ? expense_ : income_) = amount;
@@ -14,110 +17,282 @@ TradeRecord &TradeRecord::operator+= (const TradeRecord &rhs) {
   income_ += rhs.income_;
   return *this;
 }
-std::ostream &operator<< (std::ostream &os, const TradeRecord &rec) {
-  os << "+ " << Book::formatDecimal(rec.income_) << " - " << Book::formatDecimal(rec.expense_) << "\n";
+TradeRecord &TradeRecord::operator-= (const TradeRecord &rhs) {
+  expense_ -= rhs.expense_;
+  income_ -= rhs.income_;
+  return *this;
+}
+Output &operator<< (Output &os, const TradeRecord &rec) {
+  os << "+ ";
+  os.decimal(rec.income_) << " - ";
+  os.decimal(rec.expense_) << '\n';
   return os;
 }
-void TradeRecord::prettyPrint () {
-  std::string tag = isExpense_ ? ak::chalk::red("expense") : ak::chalk::green("income");
-  std::string amount = Book::formatDecimal(isExpense_ ? expense_ : income_);
-  std::cout << tag << " " << amount << std::endl;
+void TradeRecord::prettyPrint (Output &os) const {
+  if (isExpense_) {
+    os.styled("expense", Output::Color::kRed);
+  } else {
+    os.styled("income", Output::Color::kGreen);
+  }
+  os << ' ';
+  os.decimal(isExpense_ ? expense_ : income_) << '\n';
 }
 
 CmdRecord::CmdRecord (const std::string &userId, const std::string &command) : userId_(userId), command_(command) {}
-std::ostream &operator<< (std::ostream &os, const CmdRecord &rec) {
-  std::istringstream iss(rec.command_);
-  std::string argv0, args;
-  std::getline(iss, argv0, ' ');
-  std::getline(iss, args, '\n');
-  os << "[" << ak::chalk::magenta(rec.userId_.str()) << "] " << ak::chalk::bold(ak::chalk::blue(argv0)) << " " << args << '\n';
+Output &operator<< (Output &os, const CmdRecord &rec) {
+  std::string_view command = rec.command_;
+  size_t space = command.find(' ');
+  std::string_view argv0 = command.substr(0, space);
+  std::string_view args = space == std::string_view::npos ? "" : command.substr(space + 1);
+  os << '[';
+  os.styled(rec.userId_, Output::Color::kMagenta) << "] ";
+  os.styled(argv0, Output::Color::kBlue, true) << ' ' << args << '\n';
   return os;
 }
 
-void CmdRecord::printIfIsUser (const std::string &userId) {
-  if (userId == userId_.str()) std::cout << *this;
+std::string CmdRecord::userId () const {
+  return userId_;
+}
+std::string CmdRecord::serialize () const {
+  return static_cast<char>(userId_.length()) + userId_ + command_;
 }
+CmdRecord CmdRecord::deserialize (const std::string &blob) {
+  auto length = static_cast<unsigned char>(blob[0]);
+  return { blob.substr(1, length), blob.substr(1 + length) };
+}
+
+namespace {
+// 旧版定长命令记录，仅用于迁移。
+struct LegacyCmdRecord {
+  ak::file::Varchar<30> userId;
+  ak::file::Varchar<1024> command;
+};
+} // namespace
 
-int LogManager::tradeCount_ () {
-  int i;
-  tradeFile_.get(&i, 0, sizeof(i));
-  return i;
+int LogManager::tradeCount_ () const {
+  return tradeFile_.size();
 }
-int LogManager::cmdCount_ () {
-  int i;
-  cmdFile_.get(&i, 0, sizeof(i));
-  return i;
+int LogManager::tradeSumCount_ () const {
+  return tradeSumFile_.size();
+}
+int LogManager::cmdCount_ () const {
+  return cmdOffsetFile_.size();
+}
+CmdRecord LogManager::cmd_ (int i) {
+  return CmdRecord::deserialize(cmdFile_.get(cmdOffsetFile_.get(i - 1)));
+}
+std::string LogManager::migrateCmdFile_ (const std::string &name) {
+  std::string legacyName = name + "_cmd.bin";
+  std::string blobName = name + "_cmd.log";
+  std::string offsetName = name + "_cmd_offset.bin";
+  if (!std::filesystem::exists(legacyName) || std::filesystem::exists(blobName)) return blobName;
+  // 先写入临时文件，全部完成后再改名，避免中途退出留下不完整的新文件。
+  std::filesystem::remove(blobName + ".tmp");
+  std::filesystem::remove(offsetName + ".tmp");
+  {
+    ak::file::File<sizeof(LegacyCmdRecord)> legacy(legacyName.c_str());
+    BlobFile blobs((blobName + ".tmp").c_str());
+    ak::file::File<sizeof(long long)> offsets((offsetName + ".tmp").c_str());
+    int sz;
+    legacy.get(&sz, 0, sizeof(sz));
+    offsets.push(&sz, sizeof(sz));
+    for (int i = 1; i <= sz; ++i) {
+      LegacyCmdRecord rec;
+      legacy.get(&rec, i, sizeof(rec));
+      long long offset = blobs.push(CmdRecord(rec.userId, rec.command).serialize());
+      offsets.push(&offset, sizeof(offset));
+    }
+  }
+  std::filesystem::rename(offsetName + ".tmp", offsetName);
+  std::filesystem::rename(blobName + ".tmp", blobName);
+  std::filesystem::remove(legacyName);
+  return blobName;
+}
+template <typename T>
+void LogManager::migrateCountedFile_ (const std::string &filename, SegmentLog<T> &log) {
+  if (!std::filesystem::exists(filename)) return;
+  // 迁移中途退出时旧文件仍在，下次从头再来。
+  log.truncate(0);
+  {
+    ak::file::File<sizeof(T)> legacy(filename.c_str());
+    int sz;
+    legacy.get(&sz, 0, sizeof(sz));
+    for (int i = 1; i <= sz; ++i) {
+      T rec;
+      legacy.get(&rec, i, sizeof(rec));
+      log.push(rec);
+    }
+  }
+  PageCache::instance().commit();
+  std::filesystem::remove(filename);
+}
+TradeRecord LogManager::tradeSum_ (int i) {
+  if (i == 0) return TradeRecord(false, 0);
+  return tradeSumFile_.get(i - 1);
+}
+void LogManager::syncTradeSums_ () {
+  // 交易记录只会追加，已有的前缀和仍然有效，只需补上缺少的部分；
+  // 前缀和比交易记录还多说明文件已过期，截去多出的部分。
+  tradeSumFile_.truncate(tradeCount_());
+  TradeRecord sum = tradeSum_(tradeSumCount_());
+  tradeFile_.scan(tradeSumCount_(), tradeCount_(), [this, &sum] (const TradeRecord &rec) {
+    sum += rec;
+    tradeSumFile_.push(sum);
+  });
+}
+// 需要整体扫描的两个日志使用映射模式。
+LogManager::LogManager (const std::string &name) : tradeFile_(name + "_trade", true),
+  tradeSumFile_(name + "_trade_sum"),
+  cmdFile_(migrateCmdFile_(name).c_str()),
+  cmdOffsetFile_(name + "_cmd_offset", true),
+  cmdIndex_((name + "_cmd_index.dat").c_str(), false),
+  // 重放时只补上缺少的记录。崩溃前未提交的交易留下的空缺由之后的交易依次补上。
+  tradeWalId_(Wal::instance().attach(
+    name + "_trade.bin",
+    [this] {
+      std::vector<std::string> files = tradeFile_.files();
+      for (auto &file : tradeSumFile_.files()) files.push_back(file);
+      return files;
+    },
+    [this] (char, std::string_view key, std::string_view value) {
+      int id = Wal::as<int>(key);
+      if (tradeCount_() < id) replayedTrades_[id] = Wal::as<TradeRecord>(value);
+    }
+  )),
+  cmdWalId_(Wal::instance().attach(
+    name + "_cmd.log",
+    [this, name] {
+      std::vector<std::string> files = cmdOffsetFile_.files();
+      files.push_back(name + "_cmd.log");
+      files.push_back(name + "_cmd_index.dat");
+      return files;
+    },
+    [this] (char, std::string_view key, std::string_view value) {
+      replayCmd_(Wal::as<int>(key), std::string(value));
+    }
+  )) {
+  migrateCountedFile_(name + "_trade.bin", tradeFile_);
+  migrateCountedFile_(name + "_cmd_offset.bin", cmdOffsetFile_);
+  // 前缀和直接重建。
+  std::filesystem::remove(name + "_trade_sum.bin");
+  syncTradeSums_();
+  if (!cmdIndex_.existed()) rebuildCmdIndex_();
+  Wal::instance().afterReplay([this] {
+    for (const auto &[ _, rec ] : replayedTrades_) addTrade(rec);
+    replayedTrades_.clear();
+  });
+}
+LogManager::~LogManager () {
+  Wal::instance().detach(tradeWalId_);
+  Wal::instance().detach(cmdWalId_);
 }
-LogManager::LogManager (const std::string &name) : tradeFile_((name + "_trade.bin").c_str(), [this] {
-  int i = 0;
-  tradeFile_.push(&i, sizeof(i));
-}), cmdFile_((name + "_cmd.bin").c_str(), [this] {
-  int i = 0;
-  cmdFile_.push(&i, sizeof(i));
-}) {}
 void LogManager::addTrade (const TradeRecord &rec) {
-  tradeFile_.push(&rec, sizeof(rec));
+  std::lock_guard lock(tradeMutex_);
   int id = tradeCount_() + 1;
-  tradeFile_.set(&id, 0, sizeof(id));
+  Wal::instance().log(tradeWalId_, 'A', Wal::bytes(id), Wal::bytes(rec));
+  tradeFile_.push(rec);
+
+  TradeRecord sum = tradeSum_(id - 1);
+  sum += rec;
+  // 第 id 个前缀和必须落在第 id - 1 个位置上，前缀和文件若有多余的尾部先截去。
+  tradeSumFile_.truncate(id - 1);
+  tradeSumFile_.push(sum);
 }
 void LogManager::showFinance (int cnt) {
   if (cnt == 0) {
-    std::cout << '\n';
+    out() << '\n';
     return;
   }
-  int count = tradeCount_();
-  if (cnt > count) throw std::exception();
-  TradeRecord rec(false, 0);
-  for (int i = count - cnt + 1; i <= count; ++i) {
-    TradeRecord current(false, 0);
-    tradeFile_.get(&current, i, sizeof(current));
-    rec += current;
+  TradeRecord rec;
+  {
+    std::lock_guard lock(tradeMutex_);
+    int count = tradeCount_();
+    if (cnt > count) throw std::exception();
+    rec = tradeSum_(count);
+    rec -= tradeSum_(count - cnt);
   }
-  std::cout << rec;
+  out() << rec;
 }
 void LogManager::showFinance () {
-  showFinance(tradeCount_());
+  int count;
+  TradeRecord rec;
+  {
+    std::lock_guard lock(tradeMutex_);
+    count = tradeCount_();
+    rec = tradeSum_(count);
+  }
+  if (count == 0) {
+    out() << '\n';
+    return;
+  }
+  out() << rec;
 }
 void LogManager::reportFinance () {
-  int sz = tradeCount_();
-  for (int i = 1; i <= sz; ++i) {
-    TradeRecord rec;
-    tradeFile_.get(&rec, i, sizeof(rec));
-    std::cout << i << ". ";
-    rec.prettyPrint();
+  // 总额与列出的记录取自同一时刻，之后追加的交易不计入。
+  int count;
+  TradeRecord total;
+  {
+    std::lock_guard lock(tradeMutex_);
+    count = tradeCount_();
+    total = tradeSum_(count);
   }
-  std::cout << ak::chalk::magenta(ak::chalk::bold("Total")) << ": ";
-  showFinance();
+  BatchFormatter<TradeRecord> formatter(out(), [] (size_t i, const TradeRecord &rec, Output &os) {
+    os << i + 1 << ". ";
+    rec.prettyPrint(os);
+  });
+  tradeFile_.scan(0, count, [&formatter] (const TradeRecord &rec) { formatter.push(rec); });
+  formatter.flush();
+  out().styled("Total", Output::Color::kMagenta, true) << ": ";
+  if (count == 0) {
+    out() << '\n';
+    return;
+  }
+  out() << total;
+}
+void LogManager::rebuildCmdIndex_ () {
+  int i = 0;
+  cmdOffsetFile_.scan(0, cmdCount_(), [this, &i] (long long offset) {
+    cmdIndex_.add(CmdRecord::deserialize(cmdFile_.get(offset)).userId(), ++i);
+  });
+}
+// 写回时记录与索引可能只写回了一部分，已在文件中的记录也要检查索引。
+void LogManager::replayCmd_ (int id, const std::string &blob) {
+  std::string userId = CmdRecord::deserialize(blob).userId();
+  if (cmdCount_() < id) cmdOffsetFile_.push(cmdFile_.push(blob));
+  if (!cmdIndex_.find(userId, id)) cmdIndex_.add(userId, id);
 }
 void LogManager::addLog (const CmdRecord &rec) {
-  cmdFile_.push(&rec, sizeof(rec));
+  std::string blob = rec.serialize();
+  std::lock_guard lock(cmdMutex_);
   int id = cmdCount_() + 1;
-  cmdFile_.set(&id, 0, sizeof(id));
+  // 持有锁时写入预写日志，日志中的编号与文件中的顺序一致。
+  // 索引项不另记日志，与记录一起单独提交，不受当前命令成败的影响。
+  Wal::instance().logStandalone(cmdWalId_, 'A', Wal::bytes(id), blob);
+  long long offset = cmdFile_.push(blob);
+  cmdOffsetFile_.push(offset);
+  cmdIndex_.add(rec.userId(), id);
 }
 void LogManager::reportEmployee (const std::string &id_) {
-  std::cout << "Actions performed by " << ak::chalk::magenta(ak::chalk::bold(id_)) << ":" << std::endl;
-  int sz = cmdCount_();
-  for (int i = 1; i <= sz; ++i) {
-    CmdRecord rec;
-    cmdFile_.get(&rec, i, sizeof(rec));
-    rec.printIfIsUser(id_);
-  }
+  out() << "Actions performed by ";
+  out().styled(id_, Output::Color::kMagenta, true) << ":\n";
+  // 同一 key 下的 value 按升序排列，即按命令的先后顺序。
+  std::vector<int> ids;
+  cmdIndex_.query(id_, ids);
+  for (int i : ids) out() << cmd_(i);
 }
 void LogManager::reportLog () {
   const char dashes[] = "--------------------";
-  std::cout << dashes << ak::chalk::red(ak::chalk::bold(" Finance Report ")) << dashes << std::endl;
+  out() << dashes;
+  out().styled(" Finance Report ", Output::Color::kRed, true) << dashes << '\n';
   reportFinance();
-  std::cout << std::endl;
-  std::cout << dashes << ak::chalk::red(ak::chalk::bold(" System Logs ")) << dashes << std::endl;
-  int sz = cmdCount_();
-  for (int i = 1; i <= sz; ++i) {
-    CmdRecord rec;
-    cmdFile_.get(&rec, i, sizeof(rec));
-    std::cout << rec;
-  }
+  out() << '\n';
+  out() << dashes;
+  out().styled(" System Logs ", Output::Color::kRed, true) << dashes << '\n';
+  // 命令记录在本线程读出，解码与格式化交给线程池。
+  BatchFormatter<std::string> formatter(out(), [] (size_t, const std::string &blob, Output &os) {
+    os << CmdRecord::deserialize(blob);
+  });
+  cmdOffsetFile_.scan(0, cmdCount_(), [this, &formatter] (long long offset) { formatter.push(cmdFile_.get(offset)); });
+  formatter.flush();
 }
 
-void LogManager::clearCache () {
-  cmdFile_.clearCache();
-  tradeFile_.clearCache();
-}
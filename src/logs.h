@@ -3,8 +3,16 @@
 
 #include <ak/file/file.h>
 #include <ak/file/varchar.h>
+#include <map>
+#include <mutex>
 #include <string>
 
+#include "blobs.h"
+#include "bptree.h"
+#include "output.h"
+#include "segments.h"
+#include "wal.h"
+
 class TradeRecord {
  private:
   // ak::file::Varchar<30> id_
@@ -17,52 +25,96 @@ class TradeRecord {
   TradeRecord (const bool &type, long long amount);
   // 支持多笔交易记录相加。
   TradeRecord &operator+= (const TradeRecord &);
+  // 前缀和相减，用于计算一段区间内的交易总额。
+  TradeRecord &operator-= (const TradeRecord &);
   // 按照题目要求格式输出。
-  friend std::ostream &operator<< (std::ostream &, const TradeRecord &);
-  void prettyPrint ();
+  friend Output &operator<< (Output &, const TradeRecord &);
+  void prettyPrint (Output &os = out()) const;
 };
 
+// 命令记录以变长格式存储：1 字节 userId 长度 + userId + 原始命令。
 class CmdRecord {
  private:
-  ak::file::Varchar<30> userId_;  // 执行者
-  ak::file::Varchar<1024> command_;  // 原始命令
+  std::string userId_;  // 执行者
+  std::string command_;  // 原始命令
 
  public:
   CmdRecord () = default;
   CmdRecord (const std::string &, const std::string &);  // 构造函数。
-  friend std::ostream &operator<< (std::ostream &, const CmdRecord &);  // 输出重载。
-  void printIfIsUser (const std::string &userId);
+  friend Output &operator<< (Output &, const CmdRecord &);  // 输出重载。
+  std::string userId () const;
+
+  std::string serialize () const;
+  static CmdRecord deserialize (const std::string &);
 };
 
+// 可以在多个线程中同时使用：追加交易记录与追加命令记录各自由一把锁串行化，
+// 查询只在读取记录数量与前缀和时加锁。
 class LogManager {
  private:
-  ak::file::File<sizeof(TradeRecord)> tradeFile_;
-  ak::file::File<sizeof(CmdRecord)> cmdFile_;
+  // 保护交易记录与其前缀和的追加，以及读取两者一致的末尾。
+  std::mutex tradeMutex_;
+  // 保护命令记录的追加：编号的分配、预写日志与三个文件的写入按同一顺序进行。
+  std::mutex cmdMutex_;
+  SegmentLog<TradeRecord> tradeFile_;
+  // 交易记录的前缀和，第 i 条存前 i + 1 条交易记录之和。
+  SegmentLog<TradeRecord> tradeSumFile_;
+  BlobFile cmdFile_;
+  // 命令记录编号到 cmdFile_ 中偏移量的索引。
+  SegmentLog<long long> cmdOffsetFile_;
+  // 用户 id 到命令记录编号的索引，编号即 cmdFile_ 中的位置。
+  // 不单独记入预写日志，重放命令记录时由记录推出；文件不存在时从 cmdFile_ 重建。
+  BpTree<ak::file::Varchar<30>, int> cmdIndex_;
+  // 重放时读到的、文件中还没有的交易记录，按编号排列。
+  // 并发的 buy 提交的顺序可能与交易编号不同，重放结束后再按编号追加。
+  std::map<int, TradeRecord> replayedTrades_;
+  // 交易记录与命令记录在预写日志中登记的编号。
+  int tradeWalId_;
+  int cmdWalId_;
 
-  // 私有成员函数，读取文件开头存的记录数量。
-  int tradeCount_ ();
-  int cmdCount_ ();
+  // 记录数量，由分段日志的长度得出，不需要读文件。
+  int tradeCount_ () const;
+  int tradeSumCount_ () const;
+  int cmdCount_ () const;
+  // 前 i 条交易记录之和，i = 0 时为空记录。
+  TradeRecord tradeSum_ (int i);
+  // 前缀和文件缺失或与交易记录数量不一致时，从 tradeFile_ 重建。
+  void syncTradeSums_ ();
+  // 从 cmdFile_ 重建 cmdIndex_.
+  void rebuildCmdIndex_ ();
+  // 重放第 id 条命令记录：文件中没有时追加，索引中没有时补上。
+  void replayCmd_ (int id, const std::string &blob);
+  // 读取第 i 条命令记录。
+  CmdRecord cmd_ (int i);
+  // 将旧版 ak::file::File<sizeof(CmdRecord)> 格式的命令记录 name + "_cmd.bin" 一次性迁移到新格式，
+  // 新文件已存在或没有旧文件时什么都不做。返回新文件名，在初始化 cmdFile_ 时调用。
+  static std::string migrateCmdFile_ (const std::string &name);
+  // 将旧版开头存记录数量的 ak::file::File 迁移到分段日志，没有旧文件时什么都不做。
+  template <typename T>
+  static void migrateCountedFile_ (const std::string &filename, SegmentLog<T> &log);
 
  public:
-  // 初始化，文件名为 name + "_trade.bin"/"_cmd.bin".
-  // 注意，每个文件开头预留一个 int 存储交易记录/命令记录的数量。
+  // 初始化，文件名为 name + "_trade"/"_trade_sum"/"_cmd_offset" 加分段日志的后缀，
+  // 以及 name + "_cmd.log"/"_cmd_index.dat".
   LogManager (const std::string &name);
-  // 在文件末尾加入一个交易记录，并修改交易记录数量。
+  LogManager (const LogManager &) = delete;
+  LogManager &operator= (const LogManager &) = delete;
+  ~LogManager ();
+  // 在文件末尾加入一个交易记录，同时追加前缀和。
   void addTrade (const TradeRecord &);
-  // 对应题目命令，计算后 cnt 条交易记录并输出。
+  // 对应题目命令，用前缀和计算后 cnt 条交易记录并输出。
   void showFinance (int cnt);
   void showFinance ();
   // 输出所有交易记录。
   void reportFinance ();
-  // 在文件末尾加入一个命令记录，并修改命令记录数量。
+  // 在文件末尾加入一个命令记录，并修改索引。
+  // 记录单独提交到预写日志（见 Wal::logStandalone），不属于当前命令，只读命令执行时也可以调用。
   void addLog (const CmdRecord &);
-  // 对应题目命令 report myself，从头到尾查找并输出某个员工的命令记录。
-  // 对于命令 report employee，使用上述默认参数可以匹配所有 id 的记录。
-  void reportEmployee (const std::string &id_ = "");
+  // 对应题目命令 report myself，通过索引只读取并输出某个员工的命令记录。
+  // 对于命令 report employee，对每个员工分别调用。
+  void reportEmployee (const std::string &id_);
   // 可以自由决定实现方式，或者可以分别调用 ReportFinance() 和 ReportEmployee().
   void reportLog ();
-
-  void clearCache ();
 };
 
 #endif
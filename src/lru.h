@@ -0,0 +1,49 @@
+#ifndef PANIC_BOOKSTORE_LRU_H_
+#define PANIC_BOOKSTORE_LRU_H_
+
+#include <list>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+
+// 容量固定的 LRU 缓存，超出容量时丢弃最久未访问的项。
+template <typename KeyType, typename ValueType, typename Hash = std::hash<KeyType>>
+class LruCache {
+ private:
+  size_t capacity_;
+  std::list<std::pair<KeyType, ValueType>> items_;  // 最近访问的在前
+  std::unordered_map<KeyType, typename decltype(items_)::iterator, Hash> map_;
+
+ public:
+  LruCache () = delete;
+  LruCache (size_t capacity) : capacity_(capacity) {}
+  std::optional<ValueType> get (const KeyType &key) {
+    auto it = map_.find(key);
+    if (it == map_.end()) return std::nullopt;
+    items_.splice(items_.begin(), items_, it->second);
+    return it->second->second;
+  }
+  void put (const KeyType &key, const ValueType &value) {
+    auto it = map_.find(key);
+    if (it != map_.end()) {
+      it->second->second = value;
+      items_.splice(items_.begin(), items_, it->second);
+      return;
+    }
+    if (capacity_ == 0) return;
+    if (items_.size() == capacity_) {
+      map_.erase(items_.back().first);
+      items_.pop_back();
+    }
+    items_.emplace_front(key, value);
+    map_[key] = items_.begin();
+  }
+  void erase (const KeyType &key) {
+    auto it = map_.find(key);
+    if (it == map_.end()) return;
+    items_.erase(it->second);
+    map_.erase(it);
+  }
+};
+
+#endif
@@ -1,198 +1,118 @@
-#include <ak/validator.h>
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
-#include <sstream>
-#include <vector>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
 
 #include "books.h"
+#include "cache.h"
+#include "commands.h"
 #include "users.h"
 #include "logs.h"
+#include "output.h"
+#include "server.h"
+#include "stats.h"
+#include "wal.h"
 
-BookManager::FieldClause parseClause (const std::string &arg) {
-  if (arg.length() < 2) throw std::exception();
-  if (arg[1] == 'I') {
-    ak::validator::expect(arg).toMatch(R"(-ISBN=.+)");
-    return { .field = BookManager::Field::kIsbn, .payload = arg.substr(6) };
-  }
-  if (arg[1] == 'n') {
-    ak::validator::expect(arg).toMatch(R"(-name=".+")");
-    return { .field = BookManager::Field::kName, .payload = arg.substr(7, arg.length() - 8) };
-  }
-  if (arg[1] == 'a') {
-    ak::validator::expect(arg).toMatch(R"(-author=".+")");
-    return { .field = BookManager::Field::kAuthor, .payload = arg.substr(9, arg.length() - 10) };
-  }
-  if (arg[1] == 'k') {
-    ak::validator::expect(arg).toMatch(R"(-keyword=".+")");
-    return { .field = BookManager::Field::kKeyword, .payload = arg.substr(10, arg.length() - 11) };
+// 服务模式：每条连接一个终端，输出在锁外写回连接。
+// 只读命令与 buy（见 concurrent）持有共享锁并发执行，其余命令持有独占锁逐条执行。
+// 持有共享锁的命令不 fsync，攒够一组提交后在独占锁下补上组提交。
+void serve (const std::string &path, BookManager &bookManager, UserManager &userManager, LogManager &logManager) {
+  std::shared_mutex mutex;
+  Server server(path, [&] (int fd) {
+    Output os(fd);
+    redirectOutput(&os);
+    Session *session;
+    {
+      std::unique_lock lock(mutex);
+      session = userManager.openSession();
+    }
+    userManager.useSession(session);
+    LineReader reader(fd);
+    std::string rawCommand;
+    bool running = true;
+    while (running && reader.getline(rawCommand)) {
+      if (concurrent(rawCommand)) {
+        std::shared_lock lock(mutex);
+        running = execute(rawCommand, bookManager, userManager, logManager);
+        Wal::instance().commit(false);
+      } else {
+        std::unique_lock lock(mutex);
+        running = execute(rawCommand, bookManager, userManager, logManager);
+        Wal::instance().commit();
+      }
+      if (Wal::instance().syncDue()) {
+        std::unique_lock lock(mutex);
+        if (Wal::instance().syncDue()) Wal::instance().sync();
+      }
+      os.flush();
+    }
+    {
+      std::unique_lock lock(mutex);
+      userManager.closeSession(session);
+    }
+    redirectOutput(nullptr);
+  });
+  server.run();
+}
+
+// 不带参数时从标准输入读取命令；--listen <path> 以服务模式监听 Unix 域套接字 path；
+// --load <file> 批量导入书目后退出，见 BookManager::load.
+int main (int argc, char **argv) {
+  std::ios::sync_with_stdio(false);
+  // 缓存预算可以通过环境变量 BOOKSTORE_CACHE_MB 设置。
+  if (const char *budget = std::getenv("BOOKSTORE_CACHE_MB")) {
+    PageCache::instance().setBudget(std::stoull(budget) << 20);
   }
-  if (arg[1] == 'p') {
-    ak::validator::expect(arg).toMatch(R"(-price=.+)");
-    return { .field = BookManager::Field::kPrice, .payload = arg.substr(7) };
+  // 设置 BOOKSTORE_STATS_FILE 时定期把统计写到该文件，间隔为 BOOKSTORE_STATS_INTERVAL 秒（默认 60）。
+  if (const char *statsFile = std::getenv("BOOKSTORE_STATS_FILE")) {
+    const char *interval = std::getenv("BOOKSTORE_STATS_INTERVAL");
+    Stats::instance().dumpPeriodically(statsFile, interval ? std::max(1, std::atoi(interval)) : 60);
   }
-  throw std::exception();
-};
-
-int main () {
-  BookManager bookManager("books.dat", "keyword_books.dat", "author_books.dat", "name_books.dat");
-  UserManager userManager("users.dat");
+  // 覆盖索引与普通索引的文件格式不同，分开存放。另一种模式的索引此后不再随书本表更新，
+  // 删掉，切换回去时由 BookManager 从书本表重建。
+  const char *indexFiles[][3] = {
+    { "keyword_index.dat", "author_index.dat", "name_index.dat" },
+    { "keyword_index_covering.dat", "author_index_covering.dat", "name_index_covering.dat" },
+  };
+  for (const char *stale : indexFiles[!kCoveringIndex]) std::filesystem::remove(stale);
+  const auto &files = indexFiles[kCoveringIndex];
+  BookManager bookManager("books", files[0], files[1], files[2]);
+  UserManager userManager("users");
   LogManager logManager("log");
+  // 所有存储都已登记，重放上次未写回的命令。
+  Wal::instance().open("bookstore.wal");
+  // 旧版以整个书名等为 key 的索引，新索引（见 IndexKey）已在重放后从书本表重建。
+  for (const char *legacy : {
+    "keyword_books.dat", "author_books.dat", "name_books.dat",
+    "keyword_books_covering.dat", "author_books_covering.dat", "name_books_covering.dat",
+  }) std::filesystem::remove(legacy);
 
-  while (!std::cin.eof()) {
-    std::string rawCommand;
-    std::getline(std::cin, rawCommand);
-    if (rawCommand.size() > 1024) {
-      std::cout << "Invalid\n";
-      continue;
-    }
-    if (rawCommand.empty()) continue;
-    std::vector<std::string> args;
-    std::istringstream iss(rawCommand);
-    while (!iss.eof()) {
-      std::string arg;
-      std::getline(iss, arg, ' ');
-      if (!arg.empty()) args.push_back(arg);
+  if (argc == 3 && std::string_view(argv[1]) == "--load") {
+    std::ifstream catalog(argv[2]);
+    if (!catalog) {
+      std::cerr << "cannot open " << argv[2] << '\n';
+      return 1;
     }
-    if (args.empty()) continue;
-    logManager.addLog(CmdRecord(userManager.currentUser().id(), rawCommand));
-    auto nary = [&args] (int i) { if (args.size() != i + 1) throw std::exception(); };
-    try {
-      if (args[0] == "quit" || args[0] == "exit") {
-        nary(0);
-        return 0;
-      }
-      if (args[0] == "su") {
-        if (args.size() == 2) {
-          userManager.logIn(args[1]);
-        } else if (args.size() == 3) {
-          userManager.logIn(args[1], args[2]);
-        } else {
-          throw std::exception();
-        }
-      } else if (args[0] == "logout") {
-        nary(0);
-        userManager.requestPrivilege(kCustomer);
-        userManager.logOut();
-      } else if (args[0] == "register") {
-        nary(3);
-        userManager.signUp(args[1], args[2], args[3]);
-      } else if (args[0] == "passwd") {
-        userManager.requestPrivilege(kCustomer);
-        if (args.size() == 3) {
-          userManager.requestPrivilege(kRoot);
-          userManager.passwd(args[1], args[2]);
-        } else if (args.size() == 4) {
-          userManager.passwd(args[1], args[2], args[3]);
-        } else {
-          throw std::exception();
-        }
-      } else if (args[0] == "useradd") {
-        nary(4);
-        userManager.requestPrivilege(kWorker);
-        Privilege p;
-        if (args[3] == "1") {
-          p = kCustomer;
-          userManager.requestPrivilege(kWorker);
-        } else if (args[3] == "3") {
-          p = kWorker;
-          userManager.requestPrivilege(kRoot);
-        } else {
-          throw std::exception();
-        }
-        userManager.userAdd(args[1], args[2], p, args[4]);
-      } else if (args[0] == "delete") {
-        nary(1);
-        userManager.requestPrivilege(kRoot);
-        userManager.remove(args[1]);
-      } else if (args[0] == "show") {
-        if (args.size() > 1 && args[1] == "finance") {
-          userManager.requestPrivilege(kRoot);
-          if (args.size() == 2) {
-            logManager.showFinance();
-          } else if (args.size() == 3) {
-            ak::validator::expect(args[2]).toBeConsistedOf("1234567890").butNot().toBeLongerThan(10);
-            long long time = std::stoll(args[2]);
-            ak::validator::expect(time).Not().toBeGreaterThan(2'147'483'647LL);
-            logManager.showFinance(time);
-          } else {
-            throw std::exception();
-          }
-        } else {
-          userManager.requestPrivilege(kCustomer);
-          if (args.size() == 1) {
-            bookManager.show();
-          } else if (args.size() == 2) {
-            BookManager::FieldClause clause = parseClause(args[1]);
-            if (clause.field == BookManager::Field::kPrice) throw std::exception();
-            bookManager.show(clause.field, clause.payload);
-          } else {
-            throw std::exception();
-          }
-        }
-      } else if (args[0] == "buy") {
-        nary(2);
-        userManager.requestPrivilege(kCustomer);
-        ak::validator::expect(args[2]).toBeConsistedOf("1234567890").butNot().toBeLongerThan(10);
-        long long qty = std::stoll(args[2]);
-        long long price = bookManager.buy(args[1], qty);
-        logManager.addTrade(TradeRecord(false, price));
-      } else if (args[0] == "select") {
-        nary(1);
-        userManager.requestPrivilege(kWorker);
-        Book book = bookManager.select(args[1]);
-        userManager.selection() = book.isbn;
-      } else if (args[0] == "modify") {
-        ak::validator::expect(args.size()).toBeGreaterThan(1);
-        userManager.requestPrivilege(kWorker);
-        std::string isbn = userManager.selection();
-        if (isbn.empty()) throw std::exception();
-        std::vector<BookManager::FieldClause> updates;
-        bool updateIsbn = false;
-        for (int i = 1; i < args.size(); ++i) {
-          auto update = parseClause(args[i]);
-          if (update.field == BookManager::Field::kIsbn) updateIsbn = true;
-          updates.push_back(update);
-        }
-        Book book = bookManager.modify(isbn, updates);
-        if (updateIsbn) userManager.updateSeletions(isbn, book.isbn);
-      } else if (args[0] == "import") {
-        nary(2);
-        userManager.requestPrivilege(kWorker);
-        std::string isbn = userManager.selection();
-        if (isbn.empty()) throw std::exception();
-        ak::validator::expect(args[1]).toBeConsistedOf("1234567890").butNot().toBeLongerThan(10);
-        long long qty = std::stoll(args[1]);
-        long long totalCost = Book::parseDecimal(args[2]);
-        bookManager.import(isbn, qty);
-        logManager.addTrade(TradeRecord(true, totalCost));
-      } else if (args[0] == "report") {
-        nary(1);
-        ak::validator::expect(args[1]).toBeOneOf({ "myself", "finance", "employee" });
-        userManager.requestPrivilege(args[1] == "myself" ? kWorker : kRoot);
-        if (args[1] == "myself") {
-          logManager.reportEmployee(userManager.currentUser().id());
-        } else if (args[1] == "finance") {
-          logManager.reportFinance();
-        } else if (args[1] == "employee") {
-          std::vector<User> users = userManager.allUsers();
-          for (User &user : users) {
-            if (user.privilege() >= kWorker) {
-              logManager.reportEmployee(user.id());
-              std::cout << std::endl;
-            }
-          }
-        }
-      } else if (args[0] == "log") {
-        nary(0);
-        userManager.requestPrivilege(kRoot);
-        logManager.reportLog();
-      } else {
-        throw std::exception();
-      }
-    } catch (...) {
-      std::cout << "Invalid\n";
+    long long skipped;
+    long long loaded = bookManager.load(catalog, skipped);
+    std::cerr << "loaded " << loaded << " books, skipped " << skipped << " lines\n";
+  } else if (argc == 3 && std::string_view(argv[1]) == "--listen") {
+    serve(argv[2], bookManager, userManager, logManager);
+  } else {
+    std::string rawCommand;
+    bool running = true;
+    while (running && !std::cin.eof()) {
+      std::getline(std::cin, rawCommand);
+      running = execute(rawCommand, bookManager, userManager, logManager);
+      out().flush();
+      Wal::instance().commit();
     }
-    bookManager.clearCache();
-    userManager.clearCache();
-    logManager.clearCache();
   }
+  // 各存储析构时会写回剩余的缓存，在此之前让日志先落盘。
+  Wal::instance().sync();
 }
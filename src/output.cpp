@@ -0,0 +1,121 @@
+#include "output.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+// 预先拼好的 ANSI 转义序列，下标为 Output::Color.
+constexpr std::string_view kColorBegin[] = { "", "\x1b[31m", "\x1b[32m", "\x1b[34m", "\x1b[35m" };
+constexpr std::string_view kColorEnd = "\x1b[39m";
+constexpr std::string_view kBoldBegin = "\x1b[1m";
+constexpr std::string_view kBoldEnd = "\x1b[22m";
+// 只写入内存时缓冲区的初始大小。
+constexpr size_t kInitialCapacity = 4096;
+} // namespace
+
+Output::Output (int fd) : fd_(fd), colored_(isatty(fd)), buffer_(new char[kBufferSize]), capacity_(kBufferSize) {}
+Output::Output (bool colored) : fd_(-1), colored_(colored), buffer_(new char[kInitialCapacity]), capacity_(kInitialCapacity) {}
+Output::~Output () {
+  flush();
+}
+
+void Output::reserve_ (size_t size) {
+  if (size_ + size <= capacity_) return;
+  if (fd_ >= 0) {
+    flush();
+    return;
+  }
+  capacity_ = std::max(capacity_ * 2, size_ + size);
+  std::unique_ptr<char[]> buffer(new char[capacity_]);
+  std::memcpy(buffer.get(), buffer_.get(), size_);
+  buffer_ = std::move(buffer);
+}
+
+Output &Output::operator<< (std::string_view str) {
+  if (fd_ >= 0 && str.length() > capacity_) {
+    flush();
+    for (size_t written = 0; written < str.length();) {
+      ssize_t n = write(fd_, str.data() + written, str.length() - written);
+      if (n <= 0) break;
+      written += n;
+    }
+    return *this;
+  }
+  reserve_(str.length());
+  std::memcpy(buffer_.get() + size_, str.data(), str.length());
+  size_ += str.length();
+  return *this;
+}
+Output &Output::operator<< (char ch) {
+  reserve_(1);
+  buffer_[size_++] = ch;
+  return *this;
+}
+
+Output &Output::integer_ (long long value) {
+  char digits[24];
+  char *end = digits + sizeof(digits);
+  char *begin = end;
+  // 用无符号数处理，避免对 LLONG_MIN 取负溢出。
+  unsigned long long abs = value < 0 ? 0ULL - value : value;
+  do {
+    *--begin = static_cast<char>('0' + abs % 10);
+    abs /= 10;
+  } while (abs != 0);
+  if (value < 0) *--begin = '-';
+  return *this << std::string_view(begin, end - begin);
+}
+Output &Output::decimal (long long decimal) {
+  if (decimal < 0) {
+    *this << '-';
+    decimal = -decimal;
+  }
+  integer_(decimal / 100);
+  long long frac = decimal % 100;
+  char str[3] = { '.', static_cast<char>('0' + frac / 10), static_cast<char>('0' + frac % 10) };
+  return *this << std::string_view(str, sizeof(str));
+}
+
+Output &Output::styled (std::string_view text, Color color, bool bold) {
+  if (!colored_) return *this << text;
+  *this << kColorBegin[static_cast<int>(color)];
+  if (bold) *this << kBoldBegin;
+  *this << text;
+  if (bold) *this << kBoldEnd;
+  if (color != Color::kNone) *this << kColorEnd;
+  return *this;
+}
+
+void Output::flush () {
+  if (fd_ < 0) return;
+  size_t written = 0;
+  while (written < size_) {
+    ssize_t n = write(fd_, buffer_.get() + written, size_ - written);
+    if (n <= 0) break;
+    written += n;
+  }
+  size_ = 0;
+}
+bool Output::colored () const {
+  return colored_;
+}
+std::string_view Output::view () const {
+  return { buffer_.get(), size_ };
+}
+void Output::clear () {
+  size_ = 0;
+}
+
+namespace {
+thread_local Output *redirected = nullptr;
+} // namespace
+
+Output &out () {
+  static Output standard(STDOUT_FILENO);
+  return redirected ? *redirected : standard;
+}
+void redirectOutput (Output *os) {
+  redirected = os;
+}
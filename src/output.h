@@ -0,0 +1,62 @@
+#ifndef PANIC_BOOKSTORE_OUTPUT_H_
+#define PANIC_BOOKSTORE_OUTPUT_H_
+
+#include <concepts>
+#include <memory>
+#include <string_view>
+
+// 带缓冲的输出。内容先写入一块复用的大缓冲区，只在命令结束（flush()）
+// 或缓冲区写满时才真正写出。每个 Output 只归一个线程使用，无需加锁。
+// 输出目标不是终端时自动关闭颜色。
+// 也可以只写入内存，用于在其他线程格式化一段输出，再整体写到另一个 Output.
+class Output {
+ public:
+  enum class Color { kNone, kRed, kGreen, kBlue, kMagenta };
+  static constexpr size_t kBufferSize = 1 << 20;
+
+ private:
+  int fd_;  // 只写入内存时为 -1
+  bool colored_;
+  std::unique_ptr<char[]> buffer_;
+  size_t capacity_;
+  size_t size_ = 0;
+
+  void reserve_ (size_t size);
+
+ public:
+  Output () = delete;
+  explicit Output (int fd);
+  // 只写入内存的输出，缓冲区按需增长。
+  explicit Output (bool colored);
+  Output (const Output &) = delete;
+  Output &operator= (const Output &) = delete;
+  ~Output ();
+
+  Output &operator<< (std::string_view str);
+  Output &operator<< (char ch);
+  template <std::integral T>
+  Output &operator<< (T value) {
+    return integer_(static_cast<long long>(value));
+  }
+  // 以两位小数输出，decimal 为实际值的 100 倍。
+  Output &decimal (long long decimal);
+  // 输出带颜色与粗体的文本，关闭颜色时只输出文本。
+  Output &styled (std::string_view text, Color color, bool bold = false);
+
+  // 写出缓冲区的内容，只写入内存时什么都不做。
+  void flush ();
+  bool colored () const;
+  // 缓冲区中尚未写出的内容。
+  std::string_view view () const;
+  void clear ();
+
+ private:
+  Output &integer_ (long long value);
+};
+
+// 当前线程的输出，默认为标准输出。
+Output &out ();
+// 将当前线程的输出改为 os，nullptr 表示恢复为标准输出。
+void redirectOutput (Output *os);
+
+#endif
@@ -0,0 +1,45 @@
+#include "parallel.h"
+
+ThreadPool::ThreadPool (size_t threads) {
+  for (size_t i = 0; i < threads; ++i) {
+    workers_.emplace_back([this] {
+      while (true) {
+        std::packaged_task<void ()> task;
+        {
+          std::unique_lock lock(mutex_);
+          ready_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+          if (tasks_.empty()) return;
+          task = std::move(tasks_.front());
+          tasks_.pop();
+        }
+        task();
+      }
+    });
+  }
+}
+ThreadPool::~ThreadPool () {
+  {
+    std::lock_guard lock(mutex_);
+    stopping_ = true;
+  }
+  ready_.notify_all();
+  for (auto &worker : workers_) worker.join();
+}
+ThreadPool &ThreadPool::instance () {
+  static ThreadPool pool(std::max(1U, std::thread::hardware_concurrency()));
+  return pool;
+}
+
+size_t ThreadPool::size () const {
+  return workers_.size();
+}
+std::future<void> ThreadPool::submit (std::function<void ()> task) {
+  std::packaged_task<void ()> packaged(std::move(task));
+  std::future<void> future = packaged.get_future();
+  {
+    std::lock_guard lock(mutex_);
+    tasks_.push(std::move(packaged));
+  }
+  ready_.notify_one();
+  return future;
+}
@@ -0,0 +1,103 @@
+#ifndef PANIC_BOOKSTORE_PARALLEL_H_
+#define PANIC_BOOKSTORE_PARALLEL_H_
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "output.h"
+
+// 固定大小的线程池，第一次使用时创建，线程数为 CPU 核数。
+class ThreadPool {
+ private:
+  std::vector<std::thread> workers_;
+  std::queue<std::packaged_task<void ()>> tasks_;
+  std::mutex mutex_;
+  std::condition_variable ready_;
+  bool stopping_ = false;
+
+  explicit ThreadPool (size_t threads);
+
+ public:
+  ThreadPool (const ThreadPool &) = delete;
+  ThreadPool &operator= (const ThreadPool &) = delete;
+  ~ThreadPool ();
+  static ThreadPool &instance ();
+
+  size_t size () const;
+  std::future<void> submit (std::function<void ()> task);
+};
+
+// 对 items 中的每一项调用 format(i, items[i], os)，结果按顺序写到 sink.
+// 条目较多时每 kChunkSize 条一段，在线程池中并行格式化到各自的内存缓冲区，
+// 同时在途的段不超过线程数的两倍。
+// format 会被多个线程同时调用，只能读取 items 与自己的参数。
+template <typename T, typename Fn>
+void formatParallel (const std::vector<T> &items, Output &sink, const Fn &format) {
+  constexpr size_t kChunkSize = 1024;
+  if (items.size() <= kChunkSize) {
+    for (size_t i = 0; i < items.size(); ++i) format(i, items[i], sink);
+    return;
+  }
+  ThreadPool &pool = ThreadPool::instance();
+  size_t chunks = (items.size() + kChunkSize - 1) / kChunkSize;
+  size_t window = std::min(chunks, 2 * pool.size());
+  std::vector<std::unique_ptr<Output>> buffers;
+  for (size_t i = 0; i < window; ++i) buffers.push_back(std::make_unique<Output>(sink.colored()));
+  std::vector<std::future<void>> pending(window);
+  auto start = [&] (size_t chunk) {
+    Output &buffer = *buffers[chunk % window];
+    buffer.clear();
+    pending[chunk % window] = pool.submit([&items, &format, &buffer, chunk] {
+      size_t end = std::min(items.size(), (chunk + 1) * kChunkSize);
+      for (size_t i = chunk * kChunkSize; i < end; ++i) format(i, items[i], buffer);
+    });
+  };
+  for (size_t chunk = 0; chunk < window; ++chunk) start(chunk);
+  for (size_t chunk = 0; chunk < chunks; ++chunk) {
+    pending[chunk % window].get();
+    sink << buffers[chunk % window]->view();
+    if (chunk + window < chunks) start(chunk + window);
+  }
+}
+
+// 逐条接收顺序读出的条目，每攒够 kBatchSize 条调用一次 formatParallel，
+// 读文件仍在调用者的线程中进行。format 的下标为条目的全局序号。
+template <typename T>
+class BatchFormatter {
+ public:
+  using Format = std::function<void (size_t i, const T &item, Output &os)>;
+  static constexpr size_t kBatchSize = 1 << 16;
+
+ private:
+  Output &sink_;
+  Format format_;
+  std::vector<T> batch_;
+  size_t base_ = 0;
+
+ public:
+  BatchFormatter (Output &sink, Format format) : sink_(sink), format_(std::move(format)) {}
+  BatchFormatter (const BatchFormatter &) = delete;
+  BatchFormatter &operator= (const BatchFormatter &) = delete;
+
+  void push (T item) {
+    batch_.push_back(std::move(item));
+    if (batch_.size() == kBatchSize) flush();
+  }
+  // 输出所有已接收的条目，扫描结束时必须调用。
+  void flush () {
+    formatParallel(batch_, sink_, [this] (size_t i, const T &item, Output &os) {
+      format_(base_ + i, item, os);
+    });
+    base_ += batch_.size();
+    batch_.clear();
+  }
+};
+
+#endif
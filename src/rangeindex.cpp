@@ -0,0 +1,59 @@
+#include "rangeindex.h"
+
+#include <algorithm>
+#include <bit>
+
+bool RangeIndex::Entry::operator< (const Entry &rhs) const {
+  if (value != rhs.value) return value < rhs.value;
+  return isbn < rhs.isbn;
+}
+bool RangeIndex::Entry::operator== (const Entry &rhs) const {
+  return value == rhs.value && isbn == rhs.isbn;
+}
+
+RangeIndex::RangeIndex (const std::string &filename) :
+  entries_(filename.c_str()) {}
+
+bool RangeIndex::existed () const {
+  return entries_.existed();
+}
+
+int RangeIndex::bucket_ (long long value) {
+  if (value < 16) return static_cast<int>(std::max(value, 0LL));
+  // 最高位为第 e 位时，取其后 4 位作为桶内编号。
+  int e = std::bit_width(static_cast<unsigned long long>(value)) - 1;
+  return 16 + (e - 4) * 16 + static_cast<int>((value >> (e - 4)) & 15);
+}
+
+void RangeIndex::add (long long value, const Isbn &isbn) {
+  entries_.add(bucket_(value), { value, isbn });
+}
+void RangeIndex::addMissing (long long value, const Isbn &isbn) {
+  if (!entries_.find(bucket_(value), { value, isbn })) entries_.add(bucket_(value), { value, isbn });
+}
+void RangeIndex::update (long long fromValue, const Isbn &from, long long toValue, const Isbn &to) {
+  if (fromValue == toValue && from == to) return;
+  entries_.del(bucket_(fromValue), { fromValue, from });
+  entries_.add(bucket_(toValue), { toValue, to });
+}
+
+std::vector<RangeIndex::Isbn> RangeIndex::query (long long lo, long long hi, long long offset, long long limit) {
+  std::vector<Isbn> result;
+  lo = std::max(lo, 0LL);
+  if (lo > hi || limit <= 0) return result;
+  size_t count = static_cast<size_t>(limit);
+  for (int bucket = bucket_(lo); bucket <= bucket_(hi) && result.size() < count; ++bucket) {
+    std::vector<Entry> entries;
+    entries_.query(bucket, entries);
+    for (const auto &entry : entries) {
+      if (entry.value < lo || entry.value > hi) continue;
+      if (offset > 0) {
+        --offset;
+        continue;
+      }
+      result.push_back(entry.isbn);
+      if (result.size() == count) break;
+    }
+  }
+  return result;
+}
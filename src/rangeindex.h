@@ -0,0 +1,49 @@
+#ifndef PANIC_BOOKSTORE_RANGEINDEX_H_
+#define PANIC_BOOKSTORE_RANGEINDEX_H_
+
+#include <ak/file/varchar.h>
+#include <string>
+#include <vector>
+
+#include "bptree.h"
+
+// 非负整数（价格、库存）到 ISBN 的范围索引。
+// libakcpp 的 B+ 树只支持按 key 精确查询，所以 key 为数值所在的桶：
+// 小于 16 的数各占一个桶，更大的数按最高位所在的数量级再均分 16 个桶，
+// 桶的总数不超过一千，与书的数量无关。范围查询依次查询覆盖到的桶并过滤两端。
+//
+// 每个桶的倒排表一次整体读入，跳过 offset 也是逐项跳过，所以查询的代价是
+// O(覆盖到的桶的大小 + offset)，与 limit 无关。小于 16 的数各占一个桶，
+// 库存为 0 的书可能很多，show stock 0 5 也会读入整个 0 号桶。
+class RangeIndex {
+ public:
+  using Isbn = ak::file::Varchar<20>;
+  // 同一桶内按 (value, isbn) 排序。
+  struct Entry {
+    long long value;
+    Isbn isbn;
+    bool operator< (const Entry &rhs) const;
+    bool operator== (const Entry &rhs) const;
+  };
+
+ private:
+  BpTree<int, Entry> entries_;
+
+  static int bucket_ (long long value);
+
+ public:
+  RangeIndex () = delete;
+  explicit RangeIndex (const std::string &filename);
+  // 索引文件是否已存在（见 BpTree::existed），不存在则需要由调用者从书本表重建。
+  bool existed () const;
+
+  void add (long long value, const Isbn &isbn);
+  // 重建时使用：只插入树中还没有的项。文件丢失后预写日志可能已经重放了其中一部分。
+  void addMissing (long long value, const Isbn &isbn);
+  // 数值或 ISBN 变化时调用，都没变时什么都不做。
+  void update (long long fromValue, const Isbn &from, long long toValue, const Isbn &to);
+  // 数值在 [lo, hi] 内的书按 (value, isbn) 排序后，跳过 offset 本，最多返回 limit 本的 ISBN.
+  std::vector<Isbn> query (long long lo, long long hi, long long offset, long long limit);
+};
+
+#endif
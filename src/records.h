@@ -0,0 +1,97 @@
+#ifndef PANIC_BOOKSTORE_RECORDS_H_
+#define PANIC_BOOKSTORE_RECORDS_H_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "cache.h"
+
+// 定长记录文件，第 i 条记录位于 i * sizeof(T) 处，可以原地覆盖。
+// 读写都经过共享的 PageCache.
+//
+// 整体扫描时，如果文件没有未写回的页，则以只读方式把整个文件映射到内存，
+// 直接访问映射中的记录。映射按 kMapChunk 的整数倍增长，文件变长后才重新映射；
+// 旧的映射保留到析构，其他线程仍在扫描的指针不会失效。
+// 本身不加锁，由调用者（Table）负责互斥。
+template <typename T>
+class RecordFile {
+ private:
+  static constexpr long long kMapChunk = 64 << 20;
+
+  std::string filename_;
+  std::fstream file_;
+  int cacheId_;
+  long long size_ = 0;  // 记录数
+  const char *map_ = nullptr;
+  long long mapLength_ = 0;
+  std::vector<std::pair<const char *, long long>> retired_;  // 已被替换的映射
+
+ public:
+  RecordFile () = delete;
+  // 末尾不完整的记录（崩溃时写了一半）被忽略，之后的 push 会覆盖它。
+  explicit RecordFile (const std::string &filename) : filename_(filename) {
+    if (!std::filesystem::exists(filename)) std::ofstream(filename, std::ios::binary);
+    file_.open(filename, std::ios::in | std::ios::out | std::ios::binary);
+    if (!file_) throw std::exception();
+    size_ = std::filesystem::file_size(filename) / sizeof(T);
+    cacheId_ = PageCache::instance().attach(&file_);
+  }
+  RecordFile (const RecordFile &) = delete;
+  RecordFile &operator= (const RecordFile &) = delete;
+  ~RecordFile () {
+    if (map_) munmap(const_cast<char *>(map_), mapLength_);
+    for (const auto &[ map, length ] : retired_) munmap(const_cast<char *>(map), length);
+    PageCache::instance().detach(cacheId_);
+  }
+
+  long long size () const {
+    return size_;
+  }
+  // 读取第 i 条记录开头的 size 个字节。
+  void get (void *buf, long long i, size_t size = sizeof(T)) {
+    PageCache::instance().read(cacheId_, i * static_cast<long long>(sizeof(T)), buf, size);
+  }
+  // 覆盖第 i 条记录开头的 size 个字节。
+  void set (const void *buf, long long i, size_t size = sizeof(T)) {
+    PageCache::instance().write(cacheId_, i * static_cast<long long>(sizeof(T)), buf, size);
+  }
+  // 在末尾加入一条记录，不足 sizeof(T) 的部分补零，返回其编号。
+  long long push (const void *buf, size_t size = sizeof(T)) {
+    std::array<char, sizeof(T)> record {};
+    std::memcpy(record.data(), buf, std::min(size, sizeof(T)));
+    set(record.data(), size_, sizeof(T));
+    return size_++;
+  }
+  // 整个文件的只读映射，有未写回的页或映射失败时返回 nullptr，此时应改用 get.
+  // 返回的指针在析构之前有效，但只保证包含调用时已有的记录。
+  const T *map () {
+    if (!PageCache::instance().clean(cacheId_)) return nullptr;
+    long long length = size_ * static_cast<long long>(sizeof(T));
+    if (length == 0) return nullptr;
+    if (length > mapLength_) {
+      long long mapLength = (length + kMapChunk - 1) / kMapChunk * kMapChunk;
+      int fd = ::open(filename_.c_str(), O_RDONLY);
+      if (fd < 0) return nullptr;
+      void *addr = mmap(nullptr, mapLength, PROT_READ, MAP_SHARED, fd, 0);
+      ::close(fd);
+      if (addr == MAP_FAILED) return nullptr;
+      if (map_) retired_.emplace_back(map_, mapLength_);
+      map_ = static_cast<const char *>(addr);
+      mapLength_ = mapLength;
+    }
+    return reinterpret_cast<const T *>(map_);
+  }
+};
+
+#endif
@@ -0,0 +1,67 @@
+#include "search.h"
+
+#include <algorithm>
+#include <iterator>
+
+GramIndex::GramIndex (const std::string &filename) :
+  grams_(filename.c_str()) {}
+
+bool GramIndex::existed () const {
+  return grams_.existed();
+}
+
+std::set<std::string> GramIndex::gramsOf_ (std::string_view text) {
+  std::set<std::string> grams;
+  if (text.empty()) return grams;
+  std::string padded = std::string(2, kBegin) + std::string(text);
+  for (size_t i = 0; i + 3 <= padded.length(); ++i) grams.insert(padded.substr(i, 3));
+  return grams;
+}
+
+void GramIndex::add (std::string_view text, const Isbn &isbn) {
+  for (const auto &gram : gramsOf_(text)) grams_.add(gram, isbn);
+}
+void GramIndex::addMissing (std::string_view text, const Isbn &isbn) {
+  for (const auto &gram : gramsOf_(text)) if (!grams_.find(gram, isbn)) grams_.add(gram, isbn);
+}
+void GramIndex::update (std::string_view fromText, const Isbn &from, std::string_view toText, const Isbn &to) {
+  std::set<std::string> removed = gramsOf_(fromText);
+  std::set<std::string> added = gramsOf_(toText);
+  if (from == to) {
+    // ISBN 不变时，两边都有的三元组保持不动。
+    std::set<std::string> common;
+    std::set_intersection(removed.begin(), removed.end(), added.begin(), added.end(), std::inserter(common, common.end()));
+    for (const auto &gram : common) {
+      removed.erase(gram);
+      added.erase(gram);
+    }
+  }
+  for (const auto &gram : removed) grams_.del(gram, from);
+  for (const auto &gram : added) grams_.add(gram, to);
+}
+
+std::optional<std::vector<GramIndex::Isbn>> GramIndex::candidates (std::string_view query, bool prefix) {
+  std::set<std::string> grams;
+  if (prefix) {
+    grams = gramsOf_(query);
+  } else {
+    if (query.length() < 3) return std::nullopt;
+    for (size_t i = 0; i + 3 <= query.length(); ++i) grams.insert(std::string(query.substr(i, 3)));
+  }
+  std::vector<Isbn> result;
+  bool first = true;
+  for (const auto &gram : grams) {
+    std::vector<Isbn> isbns;
+    grams_.query(gram, isbns);
+    if (first) {
+      result = std::move(isbns);
+      first = false;
+    } else {
+      std::vector<Isbn> common;
+      std::set_intersection(result.begin(), result.end(), isbns.begin(), isbns.end(), std::back_inserter(common));
+      result = std::move(common);
+    }
+    if (result.empty()) break;
+  }
+  return result;
+}
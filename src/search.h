@@ -0,0 +1,45 @@
+#ifndef PANIC_BOOKSTORE_SEARCH_H_
+#define PANIC_BOOKSTORE_SEARCH_H_
+
+#include <ak/file/varchar.h>
+#include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "bptree.h"
+
+// 按字节切分的三元组（trigram）倒排索引，key 为三元组，value 为包含它的书的 ISBN.
+// 文本前面补两个 kBegin，因此前缀查询也能用三元组表示。
+// 查询只给出候选 ISBN（包含查询的所有三元组），调用者需要再检查原文。
+class GramIndex {
+ public:
+  using Gram = ak::file::Varchar<3>;
+  using Isbn = ak::file::Varchar<20>;
+  static constexpr char kBegin = '\x01';
+
+ private:
+  BpTree<Gram, Isbn> grams_;
+
+  // 需要索引的所有三元组，空文本没有三元组。
+  static std::set<std::string> gramsOf_ (std::string_view text);
+
+ public:
+  GramIndex () = delete;
+  explicit GramIndex (const std::string &filename);
+  // 索引文件是否已存在（见 BpTree::existed），不存在则需要由调用者从书本表重建。
+  bool existed () const;
+
+  void add (std::string_view text, const Isbn &isbn);
+  // 重建时使用：只插入树中还没有的项。文件丢失后预写日志可能已经重放了其中一部分。
+  void addMissing (std::string_view text, const Isbn &isbn);
+  // 文本或 ISBN 变化时调用，只改动有差别的三元组。
+  void update (std::string_view fromText, const Isbn &from, std::string_view toText, const Isbn &to);
+
+  // 文本以 query 开头（prefix 为 true）或包含 query 的候选 ISBN，升序。
+  // 包含查询短于三个字节时无法使用索引，返回 std::nullopt.
+  std::optional<std::vector<Isbn>> candidates (std::string_view query, bool prefix);
+};
+
+#endif
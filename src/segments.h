@@ -0,0 +1,236 @@
+#ifndef PANIC_BOOKSTORE_SEGMENTS_H_
+#define PANIC_BOOKSTORE_SEGMENTS_H_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "cache.h"
+#include "stats.h"
+
+// 只追加的定长记录日志，每 kRecords 条记录一个段文件：name.000000.seg, name.000001.seg, ...
+// 写满的段在末尾追加 Footer（记录数与校验和）后封存，此后不再修改，可以直接归档；
+// 最后一段为活动段，没有 Footer，记录数由文件长度得出。
+// 启动时只凭文件长度与 Footer 中的记录数认定封存段，不读其中的记录；
+// 校验和在第一次读取该段时才核对，不符时抛出异常，不会截断已有的记录。
+// 追加只是顺序写，不需要回到文件开头改写记录数，记录总数也不需要读文件。
+// 读写都经过共享的 PageCache.
+//
+// 以 mapped 模式打开时，封存且已写回的段以只读方式整段映射到内存，
+// 顺序扫描时直接访问映射中的记录，由内核预读，不再逐页 read().
+//
+// 可以一边追加一边在其他线程中读取与扫描。扫描只在取得每一段时加锁，
+// 段对象与映射在析构或 truncate 之前都不会释放。
+template <typename T, unsigned kRecords = 1 << 16>
+class SegmentLog {
+ private:
+  struct Footer {
+    unsigned count;
+    unsigned checksum;
+  };
+  struct Segment {
+    std::fstream file;
+    int cacheId;
+    const char *map = nullptr;
+    unsigned checksum = 0;  // Footer 中的校验和
+    bool verified = true;   // 启动时已封存的段在第一次读取前为 false
+  };
+  static constexpr long long kSegmentBytes = static_cast<long long>(kRecords) * sizeof(T);
+  static constexpr unsigned kChecksumSeed = 2166136261u;
+
+  std::string name_;
+  bool mapped_;
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<Segment>> segments_;  // 最后一个为活动段
+  std::atomic<long long> size_ = 0;
+  unsigned checksum_ = kChecksumSeed;  // 活动段已有记录的校验和
+
+  // FNV-1a.
+  static unsigned fnv_ (unsigned hash, const void *buf, size_t size) {
+    auto bytes = static_cast<const unsigned char *>(buf);
+    for (size_t i = 0; i < size; ++i) hash = (hash ^ bytes[i]) * 16777619u;
+    return hash;
+  }
+  // 文件开头 count 条记录的校验和。
+  static unsigned fnv_ (const std::string &filename, long long count) {
+    std::ifstream file(filename, std::ios::binary);
+    std::vector<char> buf(1 << 16);
+    unsigned hash = kChecksumSeed;
+    for (long long left = count * sizeof(T); left > 0; ) {
+      auto size = static_cast<std::streamsize>(std::min<long long>(left, buf.size()));
+      if (!file.read(buf.data(), size)) throw std::exception();
+      hash = fnv_(hash, buf.data(), size);
+      left -= size;
+    }
+    return hash;
+  }
+  // 封存段的 Footer，文件长度不是封存段的长度时返回 nullopt.
+  // 长度正确而记录数不对说明文件已损坏，抛出异常。
+  static std::optional<Footer> footer_ (const std::string &filename) {
+    if (!std::filesystem::exists(filename)) return std::nullopt;
+    if (std::filesystem::file_size(filename) != kSegmentBytes + sizeof(Footer)) return std::nullopt;
+    Footer footer;
+    std::ifstream file(filename, std::ios::binary);
+    file.seekg(kSegmentBytes);
+    if (!file.read(reinterpret_cast<char *>(&footer), sizeof(footer))) throw std::exception();
+    if (footer.count != kRecords) throw std::exception();
+    return footer;
+  }
+  std::string filename_ (size_t i) const {
+    char suffix[32];
+    std::snprintf(suffix, sizeof(suffix), ".%06zu.seg", i);
+    return name_ + suffix;
+  }
+  void open_ (size_t i) {
+    std::string filename = filename_(i);
+    if (!std::filesystem::exists(filename)) std::ofstream(filename, std::ios::binary);
+    auto segment = std::make_unique<Segment>();
+    segment->file.open(filename, std::ios::in | std::ios::out | std::ios::binary);
+    if (!segment->file) throw std::exception();
+    segment->cacheId = PageCache::instance().attach(&segment->file);
+    segments_.push_back(std::move(segment));
+  }
+  void close_ () {
+    PageCache::instance().detach(segments_.back()->cacheId);
+    if (segments_.back()->map) munmap(const_cast<char *>(segments_.back()->map), kSegmentBytes);
+    segments_.pop_back();
+  }
+  // 核对第 i 段的校验和，每段只核对一次。
+  void verify_ (size_t i) {
+    Segment &segment = *segments_[i];
+    if (segment.verified) return;
+    if (fnv_(filename_(i), kRecords) != segment.checksum) throw std::exception();
+    segment.verified = true;
+  }
+  // 第 i 段的映射，活动段、尚未写回的段或映射失败时为 nullptr.
+  const char *map_ (size_t i) {
+    Segment &segment = *segments_[i];
+    if (segment.map || !mapped_ || i + 1 == segments_.size()) return segment.map;
+    if (!PageCache::instance().clean(segment.cacheId)) return nullptr;
+    int fd = ::open(filename_(i).c_str(), O_RDONLY);
+    if (fd < 0) return nullptr;
+    void *addr = mmap(nullptr, kSegmentBytes, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) return nullptr;
+    madvise(addr, kSegmentBytes, MADV_SEQUENTIAL);
+    segment.map = static_cast<const char *>(addr);
+    return segment.map;
+  }
+  static T read_ (const Segment &segment, long long i) {
+    T value;
+    PageCache::instance().read(segment.cacheId, i % kRecords * sizeof(T), &value, sizeof(value));
+    return value;
+  }
+  // 将第 i 段作为活动段打开，丢弃末尾不完整的记录。
+  void openActive_ (size_t i) {
+    std::string filename = filename_(i);
+    long long count = 0;
+    if (std::filesystem::exists(filename)) {
+      count = std::min<long long>(std::filesystem::file_size(filename) / sizeof(T), kRecords);
+      std::filesystem::resize_file(filename, count * sizeof(T));
+    }
+    checksum_ = fnv_(filename, count);
+    size_ = static_cast<long long>(i) * kRecords + count;
+    open_(i);
+    if (count == kRecords) seal_();
+  }
+  void seal_ () {
+    Footer footer { kRecords, checksum_ };
+    PageCache::instance().write(segments_.back()->cacheId, kSegmentBytes, &footer, sizeof(footer));
+    checksum_ = kChecksumSeed;
+    open_(segments_.size());
+  }
+
+ public:
+  SegmentLog () = delete;
+  // 第一个未封存的段为活动段。其后的段只可能来自崩溃前未完整写回的数据，
+  // 一并删除，缺少的记录由预写日志重放补上。
+  SegmentLog (const std::string &name, bool mapped = false) : name_(name), mapped_(mapped) {
+    size_t i = 0;
+    while (auto footer = footer_(filename_(i))) {
+      open_(i++);
+      segments_.back()->checksum = footer->checksum;
+      segments_.back()->verified = false;
+    }
+    for (size_t j = i + 1; std::filesystem::exists(filename_(j)); ++j) std::filesystem::remove(filename_(j));
+    openActive_(i);
+  }
+  SegmentLog (const SegmentLog &) = delete;
+  SegmentLog &operator= (const SegmentLog &) = delete;
+  ~SegmentLog () {
+    while (!segments_.empty()) close_();
+  }
+
+  long long size () const {
+    return size_;
+  }
+  // 第 i 条记录，从 0 开始编号。
+  T get (long long i) {
+    std::lock_guard lock(mutex_);
+    verify_(i / kRecords);
+    if (const char *map = map_(i / kRecords)) return reinterpret_cast<const T *>(map)[i % kRecords];
+    return read_(*segments_[i / kRecords], i);
+  }
+  // 依次对第 [begin, end) 条记录调用 fn(const T &)，已映射的段不复制记录。
+  template <typename Fn>
+  void scan (long long begin, long long end, Fn fn) {
+    for (long long i = begin; i < end; ) {
+      size_t segment = i / kRecords;
+      long long last = std::min<long long>(end, (segment + 1) * static_cast<long long>(kRecords));
+      const Segment *current;
+      const char *map;
+      {
+        std::lock_guard lock(mutex_);
+        verify_(segment);
+        current = segments_[segment].get();
+        map = map_(segment);
+      }
+      if (map) {
+        const T *records = reinterpret_cast<const T *>(map);
+        for (; i < last; ++i) fn(records[i % kRecords]);
+      } else {
+        for (; i < last; ++i) fn(read_(*current, i));
+      }
+    }
+  }
+  void push (const T &value) {
+    std::lock_guard lock(mutex_);
+    PageCache::instance().write(segments_.back()->cacheId, size_ % kRecords * sizeof(T), &value, sizeof(value));
+    checksum_ = fnv_(checksum_, &value, sizeof(value));
+    Stats::instance().add(Stats::kLogAppends);
+    if (++size_ % kRecords == 0) seal_();
+  }
+  // 只保留前 n 条记录。
+  void truncate (long long n) {
+    std::lock_guard lock(mutex_);
+    if (n >= size_) return;
+    size_t active = n / kRecords;
+    while (segments_.size() > active) {
+      close_();
+      if (segments_.size() > active) std::filesystem::remove(filename_(segments_.size()));
+    }
+    std::filesystem::resize_file(filename_(active), n % kRecords * sizeof(T));
+    openActive_(active);
+  }
+  // 所有段的文件名。
+  std::vector<std::string> files () {
+    std::lock_guard lock(mutex_);
+    std::vector<std::string> files;
+    for (size_t i = 0; i < segments_.size(); ++i) files.push_back(filename_(i));
+    return files;
+  }
+};
+
+#endif
@@ -0,0 +1,109 @@
+#include "server.h"
+
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <exception>
+
+namespace {
+std::atomic<bool> stopping = false;
+void stop (int) {
+  stopping = true;
+}
+} // namespace
+
+LineReader::LineReader (int fd) : fd_(fd) {}
+bool LineReader::getline (std::string &line) {
+  while (true) {
+    size_t end = buffer_.find('\n', begin_);
+    if (end != std::string::npos) {
+      line.assign(buffer_, begin_, end - begin_);
+      begin_ = end + 1;
+      return true;
+    }
+    buffer_.erase(0, begin_);
+    begin_ = 0;
+    char buf[4096];
+    ssize_t n = read(fd_, buf, sizeof(buf));
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) {
+      if (buffer_.empty()) return false;
+      line.swap(buffer_);
+      buffer_.clear();
+      return true;
+    }
+    buffer_.append(buf, n);
+  }
+}
+
+Server::Server (const std::string &path, Handler handler) : path_(path), handler_(std::move(handler)) {
+  sockaddr_un addr {};
+  addr.sun_family = AF_UNIX;
+  if (path.length() >= sizeof(addr.sun_path)) throw std::exception();
+  std::strcpy(addr.sun_path, path.c_str());
+  listener_ = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener_ < 0) throw std::exception();
+  unlink(path.c_str());
+  if (bind(listener_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 || listen(listener_, SOMAXCONN) < 0) {
+    close(listener_);
+    throw std::exception();
+  }
+}
+Server::~Server () {
+  close(listener_);
+  unlink(path_.c_str());
+}
+
+void Server::reap_ () {
+  std::vector<std::thread> finished;
+  {
+    std::lock_guard lock(mutex_);
+    finished.swap(finished_);
+  }
+  for (auto &thread : finished) thread.join();
+}
+
+void Server::run () {
+  signal(SIGINT, stop);
+  signal(SIGTERM, stop);
+  // 客户端提前断开时让 write() 返回错误，而不是结束进程。
+  signal(SIGPIPE, SIG_IGN);
+  while (!stopping) {
+    pollfd listener { listener_, POLLIN, 0 };
+    if (poll(&listener, 1, 200) <= 0) {
+      reap_();
+      continue;
+    }
+    int fd = accept(listener_, nullptr, nullptr);
+    if (fd < 0) continue;
+    // 线程结束时要从 connections_ 中移走自己，先持有锁保证此时已经登记。
+    std::lock_guard lock(mutex_);
+    connections_[fd] = std::thread([this, fd] {
+      handler_(fd);
+      std::lock_guard lock(mutex_);
+      auto it = connections_.find(fd);
+      finished_.push_back(std::move(it->second));
+      connections_.erase(it);
+      close(fd);
+    });
+  }
+
+  {
+    std::lock_guard lock(mutex_);
+    for (const auto &[ fd, _ ] : connections_) shutdown(fd, SHUT_RD);
+  }
+  while (true) {
+    reap_();
+    {
+      std::lock_guard lock(mutex_);
+      if (connections_.empty() && finished_.empty()) break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+}
@@ -0,0 +1,51 @@
+#ifndef PANIC_BOOKSTORE_SERVER_H_
+#define PANIC_BOOKSTORE_SERVER_H_
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// 从文件描述符按行读取，行尾的 '\n' 不包含在结果中。
+class LineReader {
+ private:
+  int fd_;
+  std::string buffer_;
+  size_t begin_ = 0;
+
+ public:
+  explicit LineReader (int fd);
+  // 读到一行返回 true，连接关闭且没有剩余内容时返回 false.
+  bool getline (std::string &line);
+};
+
+// Unix 域套接字服务端，每个连接一个线程，连接的处理交给 handler(fd)，
+// handler 返回后关闭连接。收到 SIGINT/SIGTERM 后不再接受新连接，
+// 关闭所有连接的读端并等待处理线程结束。
+class Server {
+ public:
+  using Handler = std::function<void (int fd)>;
+
+ private:
+  std::string path_;
+  Handler handler_;
+  int listener_ = -1;
+  std::mutex mutex_;
+  std::unordered_map<int, std::thread> connections_;  // fd -> 处理线程
+  std::vector<std::thread> finished_;  // 已结束、等待回收的线程
+
+  void reap_ ();
+
+ public:
+  Server (const std::string &path, Handler handler);
+  Server (const Server &) = delete;
+  Server &operator= (const Server &) = delete;
+  ~Server ();
+  // 监听直到收到退出信号。
+  void run ();
+};
+
+#endif
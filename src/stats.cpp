@@ -0,0 +1,145 @@
+#include "stats.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+
+namespace {
+
+constexpr const char *kCounterNames[] = {
+  "tree_descents",
+  "tree_inserts",
+  "tree_removes",
+  "tree_scans",
+  "record_reads",
+  "record_writes",
+  "record_cache_hits",
+  "cache_hits",
+  "cache_misses",
+  "cache_evictions",
+  "cache_writebacks",
+  "wal_records",
+  "wal_bytes",
+  "wal_commits",
+  "wal_syncs",
+  "wal_checkpoints",
+  "log_appends",
+  "invalid_commands",
+};
+static_assert(std::size(kCounterNames) == Stats::kCounters);
+
+// 以两位小数输出的微秒数。
+Output &micros (Output &os, long long nanos) {
+  return os.decimal(nanos / 10);
+}
+
+} // namespace
+
+int Histogram::bucket_ (long long nanos) {
+  if (nanos < 4) return static_cast<int>(std::max(nanos, 0LL));
+  int e = std::bit_width(static_cast<unsigned long long>(nanos)) - 1;
+  int bucket = 4 + (e - 2) * 4 + static_cast<int>((nanos >> (e - 2)) & 3);
+  return std::min(bucket, kBuckets - 1);
+}
+long long Histogram::upper_ (int i) {
+  if (i < 4) return i;
+  int e = (i - 4) / 4 + 2;
+  return ((4LL + (i - 4) % 4 + 1) << (e - 2)) - 1;
+}
+
+void Histogram::record (long long nanos) {
+  buckets_[bucket_(nanos)].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(nanos, std::memory_order_relaxed);
+  long long max = max_.load(std::memory_order_relaxed);
+  while (nanos > max && !max_.compare_exchange_weak(max, nanos, std::memory_order_relaxed)) {}
+}
+long long Histogram::count () const {
+  return count_.load(std::memory_order_relaxed);
+}
+long long Histogram::sum () const {
+  return sum_.load(std::memory_order_relaxed);
+}
+long long Histogram::max () const {
+  return max_.load(std::memory_order_relaxed);
+}
+long long Histogram::percentile (double p) const {
+  long long total = 0;
+  for (const auto &bucket : buckets_) total += bucket.load(std::memory_order_relaxed);
+  if (total == 0) return 0;
+  long long rank = std::max(1LL, static_cast<long long>(p * total + 0.999999));
+  long long seen = 0;
+  for (int i = 0; i < kBuckets; ++i) {
+    seen += buckets_[i].load(std::memory_order_relaxed);
+    if (seen >= rank) return std::min(upper_(i), max());
+  }
+  return max();
+}
+void Histogram::reset () {
+  for (auto &bucket : buckets_) bucket.store(0, std::memory_order_relaxed);
+  count_.store(0, std::memory_order_relaxed);
+  sum_.store(0, std::memory_order_relaxed);
+  max_.store(0, std::memory_order_relaxed);
+}
+
+Stats &Stats::instance () {
+  static Stats stats;
+  return stats;
+}
+Stats::~Stats () {
+  {
+    std::lock_guard lock(mutex_);
+    stopping_ = true;
+  }
+  stop_.notify_all();
+  if (dumper_.joinable()) dumper_.join();
+}
+
+long long Stats::get (Counter counter) const {
+  return counters_[counter].load(std::memory_order_relaxed);
+}
+Histogram &Stats::command (std::string_view verb) {
+  std::lock_guard lock(mutex_);
+  auto it = commands_.find(verb);
+  if (it == commands_.end()) it = commands_.emplace(std::string(verb), std::make_unique<Histogram>()).first;
+  return *it->second;
+}
+void Stats::reset () {
+  for (auto &counter : counters_) counter.store(0, std::memory_order_relaxed);
+  std::lock_guard lock(mutex_);
+  for (auto &[ _, histogram ] : commands_) histogram->reset();
+}
+
+void Stats::print (Output &os) {
+  {
+    std::lock_guard lock(mutex_);
+    for (const auto &[ verb, histogram ] : commands_) {
+      long long count = histogram->count();
+      if (count == 0) continue;
+      os << verb << '\t' << count << '\t';
+      micros(os, histogram->sum() / count) << '\t';
+      micros(os, histogram->percentile(0.5)) << '\t';
+      micros(os, histogram->percentile(0.99)) << '\t';
+      micros(os, histogram->max()) << '\n';
+    }
+  }
+  for (int i = 0; i < kCounters; ++i) os << kCounterNames[i] << '\t' << get(static_cast<Counter>(i)) << '\n';
+}
+
+void Stats::dumpPeriodically (const std::string &filename, int seconds) {
+  dumper_ = std::thread([this, filename, seconds] {
+    std::string tmp = filename + ".tmp";
+    std::unique_lock lock(mutex_);
+    while (!stop_.wait_for(lock, std::chrono::seconds(seconds), [this] { return stopping_; })) {
+      lock.unlock();
+      Output os(false);
+      print(os);
+      std::ofstream(tmp, std::ios::trunc) << os.view();
+      std::error_code ec;
+      std::filesystem::rename(tmp, filename, ec);
+      lock.lock();
+    }
+  });
+}
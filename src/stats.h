@@ -0,0 +1,101 @@
+#ifndef PANIC_BOOKSTORE_STATS_H_
+#define PANIC_BOOKSTORE_STATS_H_
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "output.h"
+
+// 对数分桶的延迟直方图：每个 2 的幂区间再均分 4 个桶，分位数的误差不超过 25%.
+// 只用原子计数，可以在任何线程记录与读取。
+class Histogram {
+ public:
+  static constexpr int kBuckets = 160;
+
+ private:
+  std::array<std::atomic<long long>, kBuckets> buckets_ {};
+  std::atomic<long long> count_ = 0;
+  std::atomic<long long> sum_ = 0;
+  std::atomic<long long> max_ = 0;
+
+  static int bucket_ (long long nanos);
+  // 第 i 桶的上界。
+  static long long upper_ (int i);
+
+ public:
+  void record (long long nanos);
+  long long count () const;
+  long long sum () const;
+  long long max () const;
+  // 第 p 分位数所在桶的上界（纳秒），不超过最大值。
+  long long percentile (double p) const;
+  void reset ();
+};
+
+// 运行时统计：各类命令的延迟直方图与存储层的计数器。
+// 计数器只做一次 relaxed 原子加，可以一直开着。
+//
+// libakcpp 的树节点读写在库内部，无法直接统计，这里的 tree_* 计数的是
+// 对树的操作次数（每次查询或修改从根下降一次）。
+class Stats {
+ public:
+  enum Counter {
+    kTreeDescents,  // 查询、插入、删除各一次，批量查询每个不同的 key 一次
+    kTreeInserts,
+    kTreeRemoves,
+    kTreeScans,  // 整棵树的遍历
+    kRecordReads,  // 记录文件（Table 的 .rows）的读取，不含 hot_ 命中
+    kRecordWrites,
+    kRecordCacheHits,
+    kCacheHits,  // PageCache 的页
+    kCacheMisses,
+    kCacheEvictions,
+    kCacheWritebacks,
+    kWalRecords,
+    kWalBytes,
+    kWalCommits,
+    kWalSyncs,
+    kWalCheckpoints,
+    kLogAppends,  // 分段日志（交易记录、命令偏移）追加的记录数
+    kInvalidCommands,
+    kCounters,
+  };
+
+ private:
+  std::array<std::atomic<long long>, kCounters> counters_ {};
+  std::mutex mutex_;
+  std::map<std::string, std::unique_ptr<Histogram>, std::less<>> commands_;
+  std::thread dumper_;
+  std::condition_variable stop_;
+  bool stopping_ = false;
+
+  Stats () = default;
+
+ public:
+  Stats (const Stats &) = delete;
+  Stats &operator= (const Stats &) = delete;
+  ~Stats ();
+  static Stats &instance ();
+
+  void add (Counter counter, long long n = 1) {
+    counters_[counter].fetch_add(n, std::memory_order_relaxed);
+  }
+  long long get (Counter counter) const;
+  // 名为 verb 的命令的直方图，第一次使用时创建，之后地址不变，调用者可以保存。
+  Histogram &command (std::string_view verb);
+  void reset ();
+  // 每类命令一行：名字、次数、平均与 p50/p99/最大延迟（微秒）；然后每个计数器一行。以 '\t' 分隔。
+  void print (Output &os);
+  // 每 seconds 秒把 print() 的内容写到 filename，先写临时文件再改名，读者不会看到写了一半的文件。
+  void dumpPeriodically (const std::string &filename, int seconds);
+};
+
+#endif
@@ -0,0 +1,278 @@
+#ifndef PANIC_BOOKSTORE_TABLE_H_
+#define PANIC_BOOKSTORE_TABLE_H_
+
+#include <ak/file/bptree.h>
+#include <ak/file/file.h>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bptree.h"
+#include "cache.h"
+#include "hashindex.h"
+#include "lru.h"
+#include "records.h"
+#include "stats.h"
+#include "wal.h"
+
+// key 唯一的表。树中只存 key -> 记录编号，记录本身存在单独的定长文件中（见 RecordFile），
+// 只修改记录内容时直接覆盖原位置，不需要在树中删除再插入。
+// 文件名为 name + ".idx"/".rows"，记录文件开头预留一个位置存放 Header.
+//
+// 可选地在内存中维护 key -> 记录编号的哈希表（启动时从树中载入），
+// 并在记录文件前加一层写穿透的 LRU 缓存，这样点查询只需一次探测。
+//
+// 预写日志中记录的是逻辑操作（写入/删除某个 key 的记录），而不是记录编号，
+// 因此内部的索引树不单独记日志。
+//
+// 所有公开方法都可以在多个线程中同时调用，哈希表、LRU 缓存与记录文件由本表的锁保护。
+template <typename KeyType, typename ValueType, size_t szChunk = ak::file::kDefaultSzChunk>
+class Table {
+ private:
+  struct Header {
+    int count = 0;  // 已分配的记录位置数量
+    int freeHead = 0;  // 空闲位置链表头，0 表示没有
+  };
+  static_assert(sizeof(ValueType) >= sizeof(Header));
+
+  std::mutex mutex_;
+  BpTree<KeyType, int, szChunk> index_;
+  RecordFile<ValueType> records_;
+  int walId_;
+  std::optional<HashIndex<KeyType>> hash_;
+  LruCache<int, ValueType> hot_;
+
+  // 以 _ 结尾的非静态方法要求调用者已持有 mutex_.
+  Header header_ () {
+    Header header;
+    records_.get(&header, 0, sizeof(header));
+    return header;
+  }
+  int slot_ (const KeyType &key) {
+    if (hash_) return hash_->find(key);
+    std::vector<int> slots;
+    index_.query(key, slots);
+    return slots.empty() ? 0 : slots.front();
+  }
+  ValueType record_ (int slot) {
+    if (auto value = hot_.get(slot)) {
+      Stats::instance().add(Stats::kRecordCacheHits);
+      return *value;
+    }
+    Stats::instance().add(Stats::kRecordReads);
+    ValueType value;
+    records_.get(&value, slot, sizeof(value));
+    hot_.put(slot, value);
+    return value;
+  }
+  void setRecord_ (int slot, const ValueType &value) {
+    Stats::instance().add(Stats::kRecordWrites);
+    records_.set(&value, slot, sizeof(value));
+    hot_.put(slot, value);
+  }
+  int allocate_ (const ValueType &value) {
+    Header header = header_();
+    int slot;
+    if (header.freeHead != 0) {
+      slot = header.freeHead;
+      records_.get(&header.freeHead, slot, sizeof(header.freeHead));
+      setRecord_(slot, value);
+    } else {
+      slot = ++header.count;
+      Stats::instance().add(Stats::kRecordWrites);
+      records_.push(&value, sizeof(value));
+    }
+    records_.set(&header, 0, sizeof(header));
+    return slot;
+  }
+  void add_ (const KeyType &key, const ValueType &value) {
+    Wal::instance().log(walId_, 'P', Wal::bytes(key), Wal::bytes(value));
+    int slot = allocate_(value);
+    index_.add(key, slot);
+    if (hash_) hash_->insert(key, slot);
+  }
+  void del_ (const KeyType &key) {
+    int slot = slot_(key);
+    if (slot == 0) return;
+    Wal::instance().log(walId_, 'D', Wal::bytes(key));
+    index_.del(key, slot);
+    if (hash_) hash_->erase(key);
+    free_(slot);
+  }
+  void replay_ (char op, std::string_view key, std::string_view value) {
+    auto k = Wal::as<KeyType>(key);
+    std::lock_guard lock(mutex_);
+    int slot = slot_(k);
+    if (op == 'P') {
+      auto v = Wal::as<ValueType>(value);
+      if (slot == 0) {
+        add_(k, v);
+      } else {
+        setRecord_(slot, v);
+      }
+    }
+    if (op == 'D' && slot != 0) del_(k);
+  }
+  void free_ (int slot) {
+    hot_.erase(slot);
+    Header header = header_();
+    records_.set(&header.freeHead, slot, sizeof(header.freeHead));
+    header.freeHead = slot;
+    records_.set(&header, 0, sizeof(header));
+  }
+
+  // 旧版记录文件 legacyName 由 ak::file::File 管理，逐条复制到 RecordFile 格式的 recordName.
+  // 返回 recordName，在初始化 records_ 时调用。
+  static std::string migrateRecords_ (const std::string &legacyName, const std::string &recordName) {
+    if (!std::filesystem::exists(legacyName) || std::filesystem::exists(recordName)) return recordName;
+    std::filesystem::remove(recordName + ".tmp");
+    {
+      ak::file::File<sizeof(ValueType)> legacy(legacyName.c_str());
+      RecordFile<ValueType> records(recordName + ".tmp");
+      Header header;
+      legacy.get(&header, 0, sizeof(header));
+      for (int slot = 0; slot <= header.count; ++slot) {
+        ValueType value;
+        legacy.get(&value, slot, sizeof(value));
+        records.push(&value);
+      }
+    }
+    std::filesystem::rename(recordName + ".tmp", recordName);
+    std::filesystem::remove(legacyName);
+    return recordName;
+  }
+  // 旧版直接将 ValueType 存在树中（文件名 name + ".dat"），转换为 indexName 与 recordName.
+  // 先写入临时文件，全部完成后再改名，最后删除旧文件。返回 indexName，在初始化 index_ 时调用。
+  static const std::string &migrate_ (const std::string &name, const std::string &indexName, const std::string &recordName) {
+    std::string legacyName = name + ".dat";
+    if (!std::filesystem::exists(legacyName) || std::filesystem::exists(indexName)) return indexName;
+    std::filesystem::remove(indexName + ".tmp");
+    std::filesystem::remove(recordName + ".tmp");
+    {
+      ak::file::BpTree<KeyType, ValueType, szChunk> legacy(legacyName.c_str());
+      Table table(name + ".tmp", indexName + ".tmp", recordName + ".tmp", false, 0);
+      for (const auto &[ key, value ] : legacy.findAll()) table.add(key, value);
+    }
+    std::filesystem::rename(recordName + ".tmp", recordName);
+    std::filesystem::rename(indexName + ".tmp", indexName);
+    std::filesystem::remove(legacyName);
+    return indexName;
+  }
+  Table (
+    const std::string &name,
+    const std::string &indexName,
+    const std::string &recordName,
+    bool hashed,
+    size_t hotRecords
+  ) :
+    index_(migrate_(name, indexName, recordName).c_str(), false),
+    records_(migrateRecords_(name + ".rec", recordName)),
+    walId_(Wal::instance().attach(name, { indexName, recordName }, [this] (char op, std::string_view key, std::string_view value) {
+      replay_(op, key, value);
+    })),
+    hot_(hotRecords) {
+    if (records_.size() == 0) {
+      Header header;
+      records_.push(&header, sizeof(header));
+    }
+    if (!hashed) return;
+    hash_.emplace();
+    std::vector<std::pair<KeyType, int>> slots;
+    index_.queryAll(slots);
+    for (const auto &[ key, slot ] : slots) hash_->insert(key, slot);
+  }
+
+ public:
+  Table () = delete;
+  // hashed 为 true 时启用内存哈希索引，hotRecords 为 LRU 缓存的记录数量。
+  Table (const std::string &name, bool hashed = false, size_t hotRecords = 0) :
+    Table(name, name + ".idx", name + ".rows", hashed, hotRecords) {}
+  Table (const Table &) = delete;
+  Table &operator= (const Table &) = delete;
+  ~Table () {
+    Wal::instance().detach(walId_);
+  }
+
+  // key 须不在表中。
+  void add (const KeyType &key, const ValueType &value) {
+    std::lock_guard lock(mutex_);
+    add_(key, value);
+  }
+  void del (const KeyType &key, const ValueType &) {
+    std::lock_guard lock(mutex_);
+    del_(key);
+  }
+  bool contains (const KeyType &key) {
+    std::lock_guard lock(mutex_);
+    return slot_(key) != 0;
+  }
+  // 原地覆盖 key 的记录。记录存放的位置只由 key 决定，要改变 key 须先删除再插入。
+  void update (const KeyType &key, const ValueType &, const ValueType &newValue) {
+    std::lock_guard lock(mutex_);
+    int slot = slot_(key);
+    if (slot == 0) return;
+    Wal::instance().log(walId_, 'P', Wal::bytes(key), Wal::bytes(newValue));
+    setRecord_(slot, newValue);
+  }
+  // 比较并更新：读出 key 对应的记录交给 fn，fn 返回 true 时原地写回，返回 false 时放弃修改；
+  // fn 不能改变记录中的 key，也不能访问本表。返回是否写回。
+  template <typename Fn>
+  bool modifyInPlace (const KeyType &key, Fn fn) {
+    std::lock_guard lock(mutex_);
+    int slot = slot_(key);
+    if (slot == 0) return false;
+    ValueType value = record_(slot);
+    if (!fn(value)) return false;
+    Wal::instance().log(walId_, 'P', Wal::bytes(key), Wal::bytes(value));
+    setRecord_(slot, value);
+    return true;
+  }
+  void query (const KeyType &key, std::vector<ValueType> &result) {
+    std::lock_guard lock(mutex_);
+    result.clear();
+    int slot = slot_(key);
+    if (slot == 0) return;
+    result.push_back(record_(slot));
+  }
+  // 批量查询，keys 须已升序排列。
+  void queryBatch (const std::vector<KeyType> &keys, std::vector<ValueType> &result) {
+    std::vector<int> slots;
+    std::lock_guard lock(mutex_);
+    index_.queryBatch(keys, slots);
+    result.clear();
+    result.reserve(slots.size());
+    for (int slot : slots) result.push_back(record_(slot));
+  }
+  // 按 key 的顺序对每条记录调用 fn(record)，fn 不能修改本表。
+  // libakcpp 的树只能整体取出，因此内存占用与记录数成正比：每条记录一对 (key, 记录编号)，
+  // 与记录本身的大小无关，记录逐条读出后交给 fn.
+  // 调用 fn 时不持有本表的锁，其他线程的修改可能只有一部分可见。
+  template <typename Fn>
+  void forEach (Fn fn) {
+    std::vector<std::pair<KeyType, int>> slots;
+    const ValueType *records;
+    {
+      std::lock_guard lock(mutex_);
+      index_.queryAll(slots);
+      records = records_.map();
+    }
+    // 记录文件已全部写回时直接访问映射，不复制记录，也不经过 LRU 缓存。
+    if (records) {
+      for (const auto &[ _, slot ] : slots) fn(records[slot]);
+      return;
+    }
+    for (const auto &[ _, slot ] : slots) {
+      ValueType value;
+      {
+        std::lock_guard lock(mutex_);
+        value = record_(slot);
+      }
+      fn(value);
+    }
+  }
+};
+
+#endif
@@ -4,6 +4,8 @@
 #include <string>
 #include <vector>
 
+#include "charset.h"
+
 User::User (
   const std::string &id,
   const std::string &name,
@@ -26,30 +28,35 @@ void User::passwd (const std::string &newPassword) {
   password_ = newPassword;
 }
 
-std::string User::id () { return id_; }
+std::string User::id () const { return id_; }
 std::string User::name () { return name_; }
 std::string User::password () { return password_; }
-Privilege User::privilege () { return privilege_; }
+Privilege User::privilege () const { return privilege_; }
 
 namespace {
 using ak::validator::expect;
 } // namespace
 
 void User::validateId (const std::string &id) {
-  expect(id).toMatch(R"([0-9a-zA-Z_]+)").butNot().toBeLongerThan(30);
+  charset::expectMatch(id, charset::kWord);
+  expect(id).Not().toBeLongerThan(30);
 }
 void User::validatePassword (const std::string &password) {
-  expect(password).toMatch(R"([0-9a-zA-Z_]+)").butNot().toBeLongerThan(30);
+  charset::expectMatch(password, charset::kWord);
+  expect(password).Not().toBeLongerThan(30);
 }
 void User::validateName (const std::string &name) {
-  expect(name).toMatch(R"([\x21-\x7E]+)").butNot().toBeLongerThan(30);
+  charset::expectMatch(name, charset::kVisible);
+  expect(name).Not().toBeLongerThan(30);
 }
 void User::validatePrivilege (Privilege privilege) {
   expect(privilege).toBeOneOf({ kCustomer, kWorker, kRoot });
 }
 
+thread_local Session *UserManager::session_ = nullptr;
+
 User &UserManager::currentUser () {
-  return userStack_.back().first;
+  return session_->userStack.back().first;
 }
 
 std::optional<User> UserManager::userFromId_ (const std::string &id) {
@@ -59,14 +66,28 @@ std::optional<User> UserManager::userFromId_ (const std::string &id) {
   return res.front();
 }
 
-UserManager::UserManager (const char *filename) : users_(filename) {
+UserManager::UserManager (const char *filename) : users_(filename, true, kHotUsers) {
   auto anon = userFromId_(kAnonymous);
   if (!anon) {
     anon = User(kAnonymous, kAnonymous, kAnonymous, kGuest);
     users_.add(anon->id(), *anon);
     users_.add(kAdminId, User(kAdminId, kAdminName, kAdminPassword, kRoot));
   }
-  userStack_.emplace_back(*anon, "");
+  anonymous_ = *anon;
+  useSession(openSession());
+}
+
+Session *UserManager::openSession () {
+  Session &session = sessions_.emplace_back();
+  session.userStack.emplace_back(anonymous_, "");
+  return &session;
+}
+void UserManager::closeSession (Session *session) {
+  sessions_.remove_if([session] (const Session &s) { return &s == session; });
+  if (session_ == session) session_ = nullptr;
+}
+void UserManager::useSession (Session *session) {
+  session_ = session;
 }
 
 void UserManager::logIn (const std::string &id, const std::string &password) {
@@ -74,18 +95,16 @@ void UserManager::logIn (const std::string &id, const std::string &password) {
   auto user = userFromId_(id);
   if (!user) throw std::exception();
   if (!password.empty() && user->password() != password) throw std::exception();
-  userStack_.emplace_back(*user, "");
+  session_->userStack.emplace_back(*user, "");
 }
 void UserManager::logOut () {
-  userStack_.pop_back();
+  session_->userStack.pop_back();
 }
 void UserManager::signUp (const std::string &id, const std::string &password, const std::string &name) {
   User::validateId(id);
   User::validatePassword(password);
   User::validateName(name);
-  std::vector<User> res;
-  users_.query(id, res);
-  if (!res.empty()) throw std::exception();
+  if (users_.contains(id)) throw std::exception();
   User user(id, name, password, kCustomer);
   users_.add(user.id(), user);
 }
@@ -94,9 +113,7 @@ void UserManager::userAdd (const std::string &id, const std::string &password, P
   User::validatePassword(password);
   User::validateName(name);
   User::validatePrivilege(privilege);
-  std::vector<User> res;
-  users_.query(id, res);
-  if (!res.empty()) throw std::exception();
+  if (users_.contains(id)) throw std::exception();
   User user(id, name, password, privilege);
   users_.add(user.id(), user);
 }
@@ -107,9 +124,9 @@ void UserManager::passwd (const std::string &id, const std::string &current, con
     User::validatePassword(current);
 
     // critical area begin
-    users_.del(user->id(), *user);
+    User old = *user;
     user->passwd(current);
-    users_.add(user->id(), *user);
+    users_.update(user->id(), old, *user);
     // critical area end
 
     return;
@@ -118,36 +135,34 @@ void UserManager::passwd (const std::string &id, const std::string &current, con
   if (user->password() != current) throw std::exception();
 
   // critical area begin
-  users_.del(user->id(), *user);
+  User old = *user;
   user->passwd(newPassword);
-  users_.add(user->id(), *user);
+  users_.update(user->id(), old, *user);
   // critical area end
 }
 void UserManager::remove (const std::string &id) {
   auto user = userFromId_(id);
   if (!user || id == kAnonymous) throw std::exception();
-  for (const auto &[ user1, _ ] : userStack_) if (user->id_ == user1.id_) throw std::exception();
+  // 在任何终端登录中的用户都不能删除。
+  for (const auto &session : sessions_) {
+    for (const auto &[ user1, _ ] : session.userStack) if (user->id_ == user1.id_) throw std::exception();
+  }
   users_.del(id, *user);
 }
 
 void UserManager::requestPrivilege (Privilege privilege) {
   currentUser().requestPrivilege_(privilege);
 }
-void UserManager::clearCache () {
-  users_.clearCache();
-}
 
 std::string &UserManager::selection () {
-  return userStack_.back().second;
+  return session_->userStack.back().second;
 }
 void UserManager::updateSeletions (const std::string &old, const std::string &current) {
-  for (auto &[ _, book ] : userStack_) if (book == old) book = current;
+  for (auto &session : sessions_) {
+    for (auto &[ _, book ] : session.userStack) if (book == old) book = current;
+  }
 }
 
-std::vector<User> UserManager::allUsers () {
-  std::vector<std::pair<decltype(User::id_), User>> result;
-  users_.queryAll(result);
-  std::vector<User> users;
-  for (const auto &[ _, user ] : result) users.push_back(user);
-  return users;
+void UserManager::forEachUser (const std::function<void (const User &)> &fn) {
+  users_.forEach(fn);
 }
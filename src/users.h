@@ -3,10 +3,13 @@
 
 #include <ak/file/varchar.h>
 #include <string>
+#include <functional>
+#include <list>
 #include <optional>
 #include <vector>
 
 #include "bptree.h"
+#include "table.h"
 #include "books.h"
 
 enum Privilege { kGuest = 0, kCustomer = 1, kWorker = 3, kRoot = 7 };
@@ -22,10 +25,10 @@ class User {
   User () = default;
   User (const std::string &id, const std::string &name, const std::string &password, Privilege privilege);
 
-  std::string id ();
+  std::string id () const;
   std::string name ();
   std::string password ();
-  Privilege privilege ();
+  Privilege privilege () const;
 
   static void validateId (const std::string &id);
   static void validatePassword (const std::string &password);
@@ -36,11 +39,22 @@ class User {
   void passwd (const std::string &newPassword);
 };
 
+// 一个终端（标准输入或服务模式下的一条连接）的登录栈，
+// 每项为登录的用户与其选中的 ISBN，栈底为匿名帐号。
+struct Session {
+  std::vector<std::pair<User, std::string>> userStack;
+};
+
 class UserManager {
  private:
   // key 为 user id
-  BpTree<ak::file::Varchar<30>, User> users_;
-  std::vector<std::pair<User, std::string>> userStack_;
+  Table<ak::file::Varchar<30>, User> users_;
+  User anonymous_;
+  std::list<Session> sessions_;
+  // 当前命令所属的终端，每个线程各自设置。
+  static thread_local Session *session_;
+  // users_ 中常用用户记录的缓存大小。
+  static constexpr size_t kHotUsers = 4096;
 
   std::optional<User> userFromId_ (const std::string &id);
   static constexpr const char *kAnonymous = "<anonymous>";
@@ -49,8 +63,17 @@ class UserManager {
   static constexpr const char *kAdminPassword = "sjtu";
  public:
   UserManager () = delete;
-  // 这里应该初始化 userStack_ 为只有一个匿名帐号
+  // 初始化时打开一个终端并设为当前终端。
+  // filename 为用户表的文件名前缀，见 Table.
   UserManager (const char *filename);
+
+  // 打开一个只登录了匿名帐号的终端。
+  Session *openSession ();
+  void closeSession (Session *session);
+  // 本线程之后的命令在 session 中执行。
+  // 打开、关闭终端以及修改所有终端的 remove、updateSeletions 不能与其他命令同时执行；
+  // 其余只访问当前终端的方法可以在各自的线程中同时调用。
+  void useSession (Session *session);
   User &currentUser ();
   void logIn (const std::string &id, const std::string &password = "");
   void logOut ();
@@ -60,12 +83,12 @@ class UserManager {
   void remove (const std::string &id);
 
   void requestPrivilege (Privilege privilege);
-  void clearCache ();
 
   std::string &selection ();
   void updateSeletions (const std::string &old, const std::string &current);
 
-  std::vector<User> allUsers ();
+  // 按 id 的顺序对每个用户调用 fn.
+  void forEachUser (const std::function<void (const User &)> &fn);
 };
 
 #endif
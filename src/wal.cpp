@@ -0,0 +1,234 @@
+#include "wal.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+#include "cache.h"
+#include "stats.h"
+
+// 日志记录格式：4 字节内容长度 + 4 字节校验和 + 内容。
+// 内容为 4 字节存储名哈希 + 1 字节操作类型 + 4 字节 key 长度 + key + value.
+// 存储名哈希为 0 的记录是提交标记。
+
+namespace {
+constexpr unsigned kCommitMark = 0;
+
+unsigned checksum (std::string_view data) {
+  unsigned hash = 2166136261U;
+  for (char c : data) hash = (hash ^ static_cast<unsigned char>(c)) * 16777619U;
+  return hash;
+}
+template <typename T>
+void append (std::string &buffer, const T &value) {
+  buffer.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+// 本线程正在执行的命令已写的记录，以及提交后要做的事。
+thread_local std::string pending;
+thread_local std::vector<std::function<void ()>> committed;
+} // namespace
+
+Wal &Wal::instance () {
+  static Wal wal;
+  return wal;
+}
+Wal::~Wal () {
+  if (fd_ < 0) return;
+  write_();
+  fsync(fd_);
+  if (checkpointer_.joinable()) checkpointer_.join();
+  close(fd_);
+}
+
+unsigned Wal::hash_ (std::string_view str) {
+  unsigned hash = checksum(str);
+  return hash == kCommitMark ? 1 : hash;
+}
+
+int Wal::attach (const std::string &name, std::vector<std::string> files, Replay replay) {
+  return attach(name, [files = std::move(files)] { return files; }, std::move(replay));
+}
+int Wal::attach (const std::string &name, Files files, Replay replay) {
+  unsigned hash = hash_(name);
+  stores_[hash] = { std::move(files), std::move(replay) };
+  hashes_.push_back(hash);
+  return static_cast<int>(hashes_.size()) - 1;
+}
+void Wal::afterReplay (std::function<void ()> fn) {
+  afterReplay_.push_back(std::move(fn));
+}
+void Wal::detach (int id) {
+  stores_.erase(hashes_[id]);
+}
+
+void Wal::log (int id, char op, std::string_view key, std::string_view value) {
+  if (fd_ < 0 || replaying_) return;
+  append_(pending, hashes_[id], op, key, value);
+}
+void Wal::logStandalone (int id, char op, std::string_view key, std::string_view value) {
+  if (fd_ < 0 || replaying_) return;
+  std::lock_guard lock(mutex_);
+  append_(buffer_, hashes_[id], op, key, value);
+  append_(buffer_, kCommitMark, 'C', "", "");
+}
+void Wal::append_ (std::string &buffer, unsigned store, char op, std::string_view key, std::string_view value) {
+  std::string payload;
+  append(payload, store);
+  payload.push_back(op);
+  append(payload, static_cast<unsigned>(key.length()));
+  payload.append(key);
+  payload.append(value);
+  append(buffer, static_cast<unsigned>(payload.length()));
+  append(buffer, checksum(payload));
+  buffer.append(payload);
+  Stats::instance().add(Stats::kWalRecords);
+  Stats::instance().add(Stats::kWalBytes, 2 * sizeof(unsigned) + payload.length());
+}
+
+void Wal::write_ () {
+  size_t written = 0;
+  while (written < buffer_.length()) {
+    ssize_t n = ::write(fd_, buffer_.data() + written, buffer_.length() - written);
+    if (n <= 0) break;
+    written += n;
+  }
+  size_ += written;
+  buffer_.clear();
+}
+void Wal::sync_ () {
+  fsync(fd_);
+  Stats::instance().add(Stats::kWalSyncs);
+  uncommitted_ = 0;
+  // 日志已落盘，可以写回数据。
+  PageCache::instance().commit();
+  if (size_ >= kCheckpointSize) checkpoint_();
+}
+
+void Wal::sync () {
+  if (fd_ < 0) return;
+  std::lock_guard lock(mutex_);
+  write_();
+  sync_();
+}
+bool Wal::syncDue () {
+  std::lock_guard lock(mutex_);
+  return fd_ >= 0 && uncommitted_ >= kGroupSize;
+}
+
+void Wal::afterCommit (std::function<void ()> fn) {
+  committed.push_back(std::move(fn));
+}
+void Wal::commit (bool sync) {
+  commit_(sync);
+  std::vector<std::function<void ()>> fns;
+  fns.swap(committed);
+  for (const auto &fn : fns) fn();
+}
+void Wal::commit_ (bool sync) {
+  if (fd_ < 0) {
+    if (sync) PageCache::instance().commit();
+    return;
+  }
+  std::lock_guard lock(mutex_);
+  if (!pending.empty()) {
+    buffer_.append(pending);
+    pending.clear();
+    append_(buffer_, kCommitMark, 'C', "", "");
+  }
+  if (buffer_.empty()) return;
+  write_();
+  Stats::instance().add(Stats::kWalCommits);
+  if (++uncommitted_ >= kGroupSize && sync) sync_();
+}
+
+std::vector<std::string> Wal::files_ () const {
+  std::vector<std::string> files;
+  for (const auto &[ _, store ] : stores_) {
+    std::vector<std::string> storeFiles = store.files();
+    files.insert(files.end(), storeFiles.begin(), storeFiles.end());
+  }
+  return files;
+}
+void Wal::syncFiles_ (const std::vector<std::string> &files) {
+  for (const auto &file : files) {
+    int fd = ::open(file.c_str(), O_RDONLY);
+    if (fd < 0) continue;
+    fsync(fd);
+    close(fd);
+  }
+}
+
+void Wal::checkpoint_ () {
+  if (checkpointer_.joinable()) checkpointer_.join();
+  Stats::instance().add(Stats::kWalCheckpoints);
+  std::string old = filename_ + ".old";
+  close(fd_);
+  std::filesystem::rename(filename_, old);
+  fd_ = ::open(filename_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+  size_ = 0;
+  // 旧日志中的命令都已写回数据文件，数据文件落盘后旧日志就不再需要。
+  checkpointer_ = std::thread([files = files_(), old] {
+    syncFiles_(files);
+    std::filesystem::remove(old);
+  });
+}
+
+void Wal::replay_ (const std::string &filename) {
+  std::ifstream file(filename, std::ios::binary);
+  std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  struct Record {
+    unsigned id;
+    char op;
+    std::string_view key, value;
+  };
+  std::vector<Record> pending;
+  size_t pos = 0;
+  while (pos + 2 * sizeof(unsigned) <= data.length()) {
+    unsigned length, sum;
+    std::memcpy(&length, data.data() + pos, sizeof(length));
+    std::memcpy(&sum, data.data() + pos + sizeof(length), sizeof(sum));
+    pos += 2 * sizeof(unsigned);
+    if (pos + length > data.length()) break;
+    std::string_view payload(data.data() + pos, length);
+    pos += length;
+    // 不完整或损坏的记录说明日志在此处被截断，之后的内容都不可信。
+    if (checksum(payload) != sum || length < sizeof(unsigned) * 2 + 1) break;
+    Record rec;
+    unsigned keyLength;
+    std::memcpy(&rec.id, payload.data(), sizeof(rec.id));
+    rec.op = payload[sizeof(rec.id)];
+    std::memcpy(&keyLength, payload.data() + sizeof(rec.id) + 1, sizeof(keyLength));
+    payload.remove_prefix(sizeof(rec.id) + 1 + sizeof(keyLength));
+    if (keyLength > payload.length()) break;
+    rec.key = payload.substr(0, keyLength);
+    rec.value = payload.substr(keyLength);
+    if (rec.id != kCommitMark) {
+      pending.push_back(rec);
+      continue;
+    }
+    for (const auto &r : pending) {
+      auto it = stores_.find(r.id);
+      if (it != stores_.end()) it->second.replay(r.op, r.key, r.value);
+    }
+    pending.clear();
+  }
+}
+
+void Wal::open (const std::string &filename) {
+  filename_ = filename;
+  std::string old = filename_ + ".old";
+  replaying_ = true;
+  if (std::filesystem::exists(old)) replay_(old);
+  if (std::filesystem::exists(filename_)) replay_(filename_);
+  for (const auto &fn : afterReplay_) fn();
+  afterReplay_.clear();
+  replaying_ = false;
+  PageCache::instance().commit();
+  syncFiles_(files_());
+  std::filesystem::remove(old);
+  fd_ = ::open(filename_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+}
@@ -0,0 +1,105 @@
+#ifndef PANIC_BOOKSTORE_WAL_H_
+#define PANIC_BOOKSTORE_WAL_H_
+
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// 预写日志。每条命令对各存储的修改先以逻辑记录写入日志，命令结束时写入提交标记，
+// 一条命令的修改要么全部重放，要么全部丢弃。
+//
+// - 每条命令结束时将日志 write() 到内核，进程崩溃不会丢失已完成的命令；
+// - 每 kGroupSize 条命令 fsync 一次（组提交），之后才把数据缓存写回文件；
+// - 日志超过 kCheckpointSize 时换一个新日志文件，后台线程 fsync 所有数据文件后删除旧日志。
+//
+// 存储在构造时登记名字与重放函数，重放的记录必须是幂等的。
+// 启动时 open() 重放所有已提交的命令。
+//
+// 多个命令可以在不同线程中同时执行：log() 先记在本线程的缓冲区中，commit() 时连同提交标记
+// 一起加入日志，各命令的记录不会交错。fsync 与写回数据缓存（sync()）要求没有命令正在执行，
+// 并发执行命令时应以 commit(false) 提交，在 syncDue() 时另找没有命令执行的时机调用 sync().
+class Wal {
+ public:
+  // op 为存储自定义的操作类型。
+  using Replay = std::function<void (char op, std::string_view key, std::string_view value)>;
+  // 数据文件会增加的存储（如分段日志）每次检查点时重新获取文件列表。
+  using Files = std::function<std::vector<std::string> ()>;
+  static constexpr int kGroupSize = 32;
+  static constexpr long long kCheckpointSize = 16 << 20;
+
+ private:
+  struct Store {
+    Files files;
+    Replay replay;
+  };
+  std::unordered_map<unsigned, Store> stores_;  // key 为名字的哈希值，日志中以此区分存储
+  std::vector<unsigned> hashes_;  // attach() 返回的编号 -> 名字的哈希值
+  std::mutex mutex_;  // 保护以下写日志的状态
+  std::string filename_;
+  int fd_ = -1;
+  long long size_ = 0;
+  std::string buffer_;  // 已提交、尚未 write() 的记录
+  int uncommitted_ = 0;  // 上次 fsync 之后提交的命令数
+  bool replaying_ = false;
+  std::vector<std::function<void ()>> afterReplay_;
+  std::thread checkpointer_;
+
+  Wal () = default;
+  static unsigned hash_ (std::string_view str);
+  static void append_ (std::string &buffer, unsigned store, char op, std::string_view key, std::string_view value);
+  void write_ ();
+  void sync_ ();
+  void commit_ (bool sync);
+  void replay_ (const std::string &filename);
+  std::vector<std::string> files_ () const;
+  static void syncFiles_ (const std::vector<std::string> &files);
+  void checkpoint_ ();
+
+ public:
+  Wal (const Wal &) = delete;
+  Wal &operator= (const Wal &) = delete;
+  ~Wal ();
+  static Wal &instance ();
+
+  // 登记一个存储，files 为其数据文件，返回非负的编号。
+  int attach (const std::string &name, std::vector<std::string> files, Replay replay);
+  int attach (const std::string &name, Files files, Replay replay);
+  void detach (int id);
+  // fn 在重放之后、数据文件落盘之前调用，用于从已恢复的存储重建派生的索引；其中的修改不记日志。
+  void afterReplay (std::function<void ()> fn);
+  // 打开日志并重放，在所有存储登记完成后调用。
+  void open (const std::string &filename);
+  // 当前命令的一条记录。
+  void log (int id, char op, std::string_view key, std::string_view value = "");
+  // 不属于任何命令、单独提交的一条记录，随下一次 commit() 写出。
+  // 同一存储的记录在日志中的顺序就是调用的顺序，需要时由调用者加锁保证与修改的顺序一致。
+  void logStandalone (int id, char op, std::string_view key, std::string_view value = "");
+  // 命令结束时调用。sync 为 false 时即使攒够一组也不 fsync.
+  void commit (bool sync = true);
+  // 本线程的当前命令提交、记录已加入日志之后调用 fn，用于把锁持有到提交为止，
+  // 这样修改同一条记录的命令在日志中的顺序与修改的顺序一致。
+  void afterCommit (std::function<void ()> fn);
+  // 上次 fsync 之后已经提交了至少 kGroupSize 条命令。
+  bool syncDue ();
+  // 立即 fsync 日志并写回所有数据缓存，须在没有命令执行时调用；退出前在析构各存储之前调用。
+  void sync ();
+
+  // 定长对象与日志记录之间的转换。
+  template <typename T>
+  static std::string_view bytes (const T &obj) {
+    return { reinterpret_cast<const char *>(&obj), sizeof(obj) };
+  }
+  template <typename T>
+  static T as (std::string_view bytes) {
+    T obj;
+    std::memcpy(static_cast<void *>(&obj), bytes.data(), sizeof(obj));
+    return obj;
+  }
+};
+
+#endif
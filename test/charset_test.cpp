@@ -0,0 +1,123 @@
+// charset.h 与原先正则表达式检查的差分测试：对随机生成的字符串分别用 CharClass
+// 和 std::regex_match 判断，两者结果必须一致。
+//
+// 用法：charset_test [cases [seed]]
+
+#include <cstdio>
+#include <random>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "charset.h"
+
+namespace {
+
+// 边界附近的字符出现得更频繁：控制字符、空格、'"'、可见字符的两端、DEL 以及高位字节。
+const std::string kAlphabet = [] {
+  std::string chars = std::string("\0\t\n\r \x21\"#09:@AZ[_`az{~\x7F", 22);
+  chars += "\x80\xA0\xFE\xFF";
+  return chars;
+}();
+
+std::string randomString (std::mt19937 &rng, size_t maxLength) {
+  std::uniform_int_distribution<size_t> length(0, maxLength);
+  std::uniform_int_distribution<int> pick(0, 3);
+  std::uniform_int_distribution<size_t> fromAlphabet(0, kAlphabet.size() - 1);
+  std::uniform_int_distribution<int> anyByte(0, 255);
+  std::string str(length(rng), '\0');
+  for (char &c : str) c = pick(rng) == 0 ? static_cast<char>(anyByte(rng)) : kAlphabet[fromAlphabet(rng)];
+  return str;
+}
+
+// prefix + 随机内容 + suffix，偶尔截断或改动前后缀，以覆盖不匹配的情况。
+std::string randomClause (std::mt19937 &rng, std::string_view prefix, std::string_view suffix) {
+  std::string str = std::string(prefix) + randomString(rng, 6) + std::string(suffix);
+  std::uniform_int_distribution<int> mutate(0, 7);
+  std::uniform_int_distribution<size_t> position(0, str.size() - 1);
+  switch (mutate(rng)) {
+    case 0: str.erase(position(rng), 1); break;
+    case 1: str[position(rng)] = kAlphabet[position(rng) % kAlphabet.size()]; break;
+    case 2: str = str.substr(0, position(rng)); break;
+    default: break;
+  }
+  return str;
+}
+
+bool throws (auto fn) {
+  try {
+    fn();
+  } catch (...) {
+    return true;
+  }
+  return false;
+}
+
+struct Pattern {
+  const char *regex;
+  charset::CharClass cls;
+};
+struct Clause {
+  const char *regex;
+  std::string_view prefix, suffix;
+};
+
+std::string escape (std::string_view str) {
+  std::string result;
+  for (unsigned char c : str) {
+    char buf[8];
+    std::snprintf(buf, sizeof(buf), c >= 0x20 && c < 0x7F ? "%c" : "\\x%02X", c);
+    result += buf;
+  }
+  return result;
+}
+
+} // namespace
+
+int main (int argc, char **argv) {
+  long long cases = argc > 1 ? std::stoll(argv[1]) : 200000;
+  std::mt19937 rng(argc > 2 ? std::stoul(argv[2]) : 1953);
+
+  // 替换前 Book/User 的检查与 parseClause 中使用的正则表达式。
+  const Pattern patterns[] = {
+    { R"([\x21-\x7E]+)", charset::kVisible },
+    { R"([0-9a-zA-Z_]+)", charset::kWord },
+    { R"([0-9]+)", charset::kDigit },
+  };
+  const Clause clauses[] = {
+    { R"(-ISBN=.+)", "-ISBN=", "" },
+    { R"(-price=.+)", "-price=", "" },
+    { R"(-name=".+")", "-name=\"", "\"" },
+    { R"(-author=".+")", "-author=\"", "\"" },
+    { R"(-keyword=".+")", "-keyword=\"", "\"" },
+    { R"(-name-prefix=".+")", "-name-prefix=\"", "\"" },
+    { R"(-author-contains=".+")", "-author-contains=\"", "\"" },
+  };
+  std::vector<std::regex> patternRegexes, clauseRegexes;
+  for (const auto &pattern : patterns) patternRegexes.emplace_back(pattern.regex);
+  for (const auto &clause : clauses) clauseRegexes.emplace_back(clause.regex);
+
+  long long mismatches = 0;
+  auto report = [&mismatches] (const char *regex, const std::string &str, bool expected) {
+    if (++mismatches <= 20) {
+      std::printf("mismatch: %s on \"%s\": regex %s\n", regex, escape(str).c_str(), expected ? "accepts" : "rejects");
+    }
+  };
+  for (long long i = 0; i < cases; ++i) {
+    std::string str = randomString(rng, 8);
+    for (size_t j = 0; j < std::size(patterns); ++j) {
+      bool expected = std::regex_match(str, patternRegexes[j]);
+      if (patterns[j].cls.matches(str) != expected) report(patterns[j].regex, str, expected);
+      if (throws([&] { charset::expectMatch(str, patterns[j].cls); }) == expected) report(patterns[j].regex, str, expected);
+    }
+    for (size_t j = 0; j < std::size(clauses); ++j) {
+      std::string clause = randomClause(rng, clauses[j].prefix, clauses[j].suffix);
+      bool expected = std::regex_match(clause, clauseRegexes[j]);
+      bool rejected = throws([&] { charset::expectMatch(clause, clauses[j].prefix, charset::kAny, clauses[j].suffix); });
+      if (rejected == expected) report(clauses[j].regex, clause, expected);
+    }
+  }
+  std::printf("%lld cases, %lld mismatches\n", cases, mismatches);
+  return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,231 @@
+// 服务模式的并发压力测试：启动 code --listen，多个客户端同时对几本书 buy，
+// 其中一本库存不足、所有客户端都在抢。结束后检查每本书的库存与 show finance
+// 是否与成功的 buy 一致；然后以 SIGKILL 结束服务并重启，再检查一次，
+// 此时还没写回的修改只能从预写日志重放，检验并发提交在日志中的顺序。
+//
+// 用法：stress_test <code 可执行文件> [clients [buys]]
+
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr int kBooks = 8;
+constexpr long long kImportCost = 100;  // 每次进货的总价，以分计
+
+std::string isbnOf (int book) {
+  return "STRESS-" + std::to_string(book);
+}
+long long priceOf (int book) {
+  return 100 * (book + 1) + 25;
+}
+std::string decimal (long long cents) {
+  char buf[32];
+  std::snprintf(buf, sizeof(buf), "%lld.%02lld", cents / 100, cents % 100);
+  return buf;
+}
+
+pid_t startServer (const std::string &binary, const std::string &dir, const std::string &socketPath) {
+  pid_t pid = fork();
+  if (pid == 0) {
+    if (chdir(dir.c_str()) != 0) _exit(127);
+    execl(binary.c_str(), binary.c_str(), "--listen", socketPath.c_str(), static_cast<char *>(nullptr));
+    _exit(127);
+  }
+  return pid;
+}
+void stopServer (pid_t pid, int signal = SIGTERM) {
+  kill(pid, signal);
+  waitpid(pid, nullptr, 0);
+}
+// 出错时保留数据目录以便检查。
+int fail (pid_t server, const std::string &dir) {
+  stopServer(server);
+  std::printf("data kept in %s\n", dir.c_str());
+  return 1;
+}
+
+// 在一条连接中依次发送 commands，读完服务端的全部输出后返回。
+// 服务端刚启动时可能还没有开始监听，连接失败时重试一段时间。
+std::string session (const std::string &socketPath, const std::vector<std::string> &commands) {
+  sockaddr_un addr {};
+  addr.sun_family = AF_UNIX;
+  std::strcpy(addr.sun_path, socketPath.c_str());
+  int fd = -1;
+  for (int attempt = 0; attempt < 200 && fd < 0; ++attempt) {
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0) break;
+    close(fd);
+    fd = -1;
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  if (fd < 0) {
+    std::printf("cannot connect to %s\n", socketPath.c_str());
+    std::exit(1);
+  }
+  std::string request;
+  for (const auto &command : commands) request += command + '\n';
+  // 输出可能很长，另开线程发送，以免双方都阻塞在写上。
+  std::thread sender([fd, &request] {
+    for (size_t written = 0; written < request.length(); ) {
+      ssize_t n = write(fd, request.data() + written, request.length() - written);
+      if (n <= 0) break;
+      written += n;
+    }
+    shutdown(fd, SHUT_WR);
+  });
+  std::string response;
+  char buf[4096];
+  for (ssize_t n; (n = read(fd, buf, sizeof(buf))) > 0; ) response.append(buf, n);
+  sender.join();
+  close(fd);
+  return response;
+}
+
+std::vector<std::string> lines (const std::string &text) {
+  std::vector<std::string> result;
+  std::istringstream iss(text);
+  for (std::string line; std::getline(iss, line); ) result.push_back(line);
+  return result;
+}
+
+// 查询每本书的库存与 show finance，与期望不符时输出差别并返回 false.
+bool verify (const std::string &socketPath, const std::vector<long long> &stock, const std::string &finance, const char *when) {
+  std::vector<std::string> commands = { "su root sjtu" };
+  for (int book = 0; book < kBooks; ++book) commands.push_back("show -ISBN=" + isbnOf(book));
+  commands.push_back("show finance");
+  auto output = lines(session(socketPath, commands));
+  if (output.size() != kBooks + 1) {
+    std::printf("%s: expected %d lines, got %zu\n", when, kBooks + 1, output.size());
+    return false;
+  }
+  bool ok = true;
+  for (int book = 0; book < kBooks; ++book) {
+    std::string quantity = output[book].substr(output[book].rfind('\t') + 1);
+    if (quantity != std::to_string(stock[book])) {
+      std::printf("%s: %s has stock %s, expected %lld\n", when, isbnOf(book).c_str(), quantity.c_str(), stock[book]);
+      ok = false;
+    }
+  }
+  if (output[kBooks] != finance) {
+    std::printf("%s: show finance printed \"%s\", expected \"%s\"\n", when, output[kBooks].c_str(), finance.c_str());
+    ok = false;
+  }
+  return ok;
+}
+
+} // namespace
+
+int main (int argc, char **argv) {
+  if (argc < 2) {
+    std::printf("usage: %s <code> [clients [buys]]\n", argv[0]);
+    return 2;
+  }
+  std::string binary = std::filesystem::absolute(argv[1]);
+  int clients = argc > 2 ? std::atoi(argv[2]) : 8;
+  int buys = argc > 3 ? std::atoi(argv[3]) : 400;
+  char dirTemplate[] = "/tmp/bookstore-stress-XXXXXX";
+  if (!mkdtemp(dirTemplate)) {
+    std::perror("mkdtemp");
+    return 1;
+  }
+  std::string dir = dirTemplate;
+  std::string socketPath = dir + "/bookstore.sock";
+  pid_t server = startServer(binary, dir, socketPath);
+
+  // 第 0 本书的库存只够四分之一的请求，其余的书足够所有请求。
+  std::vector<long long> stock(kBooks);
+  std::vector<std::string> setup = { "su root sjtu" };
+  for (int book = 0; book < kBooks; ++book) {
+    stock[book] = book == 0 ? clients * buys / 4 / 2 : clients * buys;
+    setup.push_back("select " + isbnOf(book));
+    setup.push_back("modify -price=" + decimal(priceOf(book)));
+    setup.push_back("import " + std::to_string(stock[book]) + " " + decimal(kImportCost));
+  }
+  if (!session(socketPath, setup).empty()) {
+    std::printf("setup failed\n");
+    return fail(server, dir);
+  }
+
+  // 每个客户端交替购买第 0 本书与一本其他的书，另有两个客户端同时只读。
+  std::vector<std::string> outputs(clients);
+  std::vector<std::thread> threads;
+  for (int c = 0; c < clients; ++c) {
+    threads.emplace_back([&, c] {
+      std::vector<std::string> commands = { "su root sjtu" };
+      for (int k = 0; k < buys; ++k) {
+        int book = k % 2 == 0 ? 0 : 1 + (c + k) % (kBooks - 1);
+        commands.push_back("buy " + isbnOf(book) + " 1");
+      }
+      outputs[c] = session(socketPath, commands);
+    });
+  }
+  for (int r = 0; r < 2; ++r) {
+    threads.emplace_back([&] {
+      std::vector<std::string> commands = { "su root sjtu" };
+      for (int k = 0; k < buys / 4; ++k) {
+        commands.push_back("show finance");
+        commands.push_back("show stock 0 1000000");
+        commands.push_back("report finance");
+      }
+      session(socketPath, commands);
+    });
+  }
+  for (auto &thread : threads) thread.join();
+
+  long long income = 0;
+  long long sold = 0;
+  for (int c = 0; c < clients; ++c) {
+    auto output = lines(outputs[c]);
+    if (output.size() != static_cast<size_t>(buys)) {
+      std::printf("client %d: expected %d lines, got %zu\n", c, buys, output.size());
+      return fail(server, dir);
+    }
+    for (int k = 0; k < buys; ++k) {
+      int book = k % 2 == 0 ? 0 : 1 + (c + k) % (kBooks - 1);
+      if (output[k] == "Invalid") continue;
+      if (output[k] != decimal(priceOf(book))) {
+        std::printf("client %d: buy %s printed \"%s\"\n", c, isbnOf(book).c_str(), output[k].c_str());
+        return fail(server, dir);
+      }
+      --stock[book];
+      income += priceOf(book);
+      ++sold;
+    }
+  }
+  bool ok = true;
+  if (stock[0] != 0) {
+    std::printf("%s was not sold out: %lld left\n", isbnOf(0).c_str(), stock[0]);
+    ok = false;
+  }
+  for (int book = 0; book < kBooks; ++book) {
+    if (stock[book] < 0) {
+      std::printf("%s was oversold by %lld\n", isbnOf(book).c_str(), -stock[book]);
+      ok = false;
+    }
+  }
+  std::string finance = "+ " + decimal(income) + " - " + decimal(kBooks * kImportCost);
+  ok = verify(socketPath, stock, finance, "running") && ok;
+  stopServer(server, SIGKILL);
+
+  server = startServer(binary, dir, socketPath);
+  ok = verify(socketPath, stock, finance, "restarted") && ok;
+  std::printf("%d clients, %lld books sold\n", clients, sold);
+  if (!ok) return fail(server, dir);
+  stopServer(server);
+  std::filesystem::remove_all(dir);
+  return 0;
+}